@@ -12,7 +12,7 @@ public class BurstRhythmGame : ModuleRules
 		PublicDependencyModuleNames.AddRange(new string[]
 		{
 			"Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput",
-			"DesktopPlatform", "SignalProcessing"
+			"DesktopPlatform", "SignalProcessing", "Json", "AudioMixer"
 		});
 		
 		PublicIncludePaths.Add(Path.Combine(ModuleDirectory, "../ThirdParty/AudioDecoders"));
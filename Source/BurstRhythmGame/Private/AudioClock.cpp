@@ -0,0 +1,97 @@
+#include "AudioClock.h"
+
+namespace
+{
+    //Reports come in bursts a render buffer or two apart, so one report only moves the position a tenth of the way towards it and the
+    //rate by much less. Anything further off than SnapSec is a stall or a restart rather than drift and re-anchors the clock
+    constexpr double PositionGain = 0.1;
+    constexpr double RateGain     = 0.005;
+    constexpr double MaxRateError = 0.02;
+    constexpr double SnapSec      = 0.1;
+}
+
+void FAudioClock::Reset(int32 InSampleRate)
+{
+    SampleRate     = InSampleRate;
+    bAnchored      = false;
+    AnchorPlatform = 0.0;
+    AnchorSong     = 0.0;
+    Rate           = 1.0;
+
+    Sequence.store(0, std::memory_order_relaxed);
+    PublishedPlatform.store(0.0, std::memory_order_relaxed);
+    PublishedSong.store(0.0, std::memory_order_relaxed);
+    PublishedRate.store(1.0, std::memory_order_release);
+}
+
+void FAudioClock::Observe(int64 PlayedFrames, double PlatformSeconds)
+{
+    if (SampleRate <= 0)
+        return;
+
+    const double Observed = (double)PlayedFrames / (double)SampleRate;
+    if (!bAnchored)
+    {
+        bAnchored      = true;
+        AnchorPlatform = PlatformSeconds;
+        AnchorSong     = Observed;
+        Publish();
+        return;
+    }
+
+    const double Elapsed   = PlatformSeconds - AnchorPlatform;
+    const double Predicted = AnchorSong + Elapsed * Rate;
+    const double Error     = Observed - Predicted;
+
+    if (FMath::Abs(Error) > SnapSec)
+    {
+        AnchorSong = Observed;
+    }
+    else
+    {
+        AnchorSong = Predicted + PositionGain * Error;
+        if (Elapsed > 1e-3)
+            Rate = FMath::Clamp(Rate + RateGain * Error / Elapsed, 1.0 - MaxRateError, 1.0 + MaxRateError);
+    }
+    AnchorPlatform = PlatformSeconds;
+    Publish();
+}
+
+void FAudioClock::Publish()
+{
+    //Readers that see an odd or changed sequence retry, so they never mix fields from two publishes
+    const uint32 Odd = Sequence.load(std::memory_order_relaxed) + 1u;
+    Sequence.store(Odd, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    PublishedPlatform.store(AnchorPlatform, std::memory_order_relaxed);
+    PublishedSong.store(AnchorSong, std::memory_order_relaxed);
+    PublishedRate.store(Rate, std::memory_order_relaxed);
+
+    Sequence.store(Odd + 1u, std::memory_order_release);
+}
+
+double FAudioClock::GetSeconds(double PlatformSeconds) const
+{
+    for (;;)
+    {
+        const uint32 Before = Sequence.load(std::memory_order_acquire);
+        if (Before == 0)
+            return 0.0;
+        if (Before & 1u)
+            continue;
+
+        const double AtPlatform = PublishedPlatform.load(std::memory_order_relaxed);
+        const double AtSong     = PublishedSong.load(std::memory_order_relaxed);
+        const double AtRate     = PublishedRate.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (Sequence.load(std::memory_order_relaxed) == Before)
+            return AtSong + (PlatformSeconds - AtPlatform) * AtRate;
+    }
+}
+
+double FAudioClock::GetRate() const
+{
+    return PublishedRate.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,92 @@
+#include "AudioIngest.h"
+
+#include "AudioScratchPool.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "../ThirdParty/AudioDecoders/minimp3_ex.h"
+
+bool FAudioIngest::Open(const FString& FilePath, bool bAllowMap, FAudioScratchPool* InPool)
+{
+    Reset();
+
+    if (bAllowMap)
+    {
+        MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+        if (MappedFile)
+            MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+        if (MappedRegion)
+        {
+            Data     = MappedRegion->GetMappedPtr();
+            NumBytes = MappedRegion->GetMappedSize();
+            Container = Probe(Data, NumBytes);
+            return true;
+        }
+        MappedFile.Reset();
+    }
+
+    if (!InPool)
+    {
+        TArray<uint8> Bytes;
+        if (!FFileHelper::LoadFileToArray(Bytes, *FilePath))
+            return false;
+        Assign(MoveTemp(Bytes));
+        return true;
+    }
+
+    TUniquePtr<IFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FilePath));
+    if (!Handle || Handle->Size() > MAX_int32)
+        return false;
+
+    TArray<uint8> Bytes = InPool->Acquire(Handle->Size());
+    if (!Handle->Read(Bytes.GetData(), Bytes.Num()))
+    {
+        InPool->Release(MoveTemp(Bytes));
+        return false;
+    }
+    Assign(MoveTemp(Bytes));
+    Pool = InPool;
+    return true;
+}
+
+void FAudioIngest::Assign(TArray<uint8>&& InBytes)
+{
+    Reset();
+    OwnedBytes = MoveTemp(InBytes);
+    Data       = OwnedBytes.GetData();
+    NumBytes   = OwnedBytes.Num();
+    Container  = Probe(Data, NumBytes);
+}
+
+void FAudioIngest::Reset()
+{
+    //The region has to go before the handle it was mapped from
+    MappedRegion.Reset();
+    MappedFile.Reset();
+    if (Pool)
+        Pool->Release(MoveTemp(OwnedBytes));
+    OwnedBytes.Empty();
+    Pool = nullptr;
+    Data = nullptr;
+    NumBytes = 0;
+    Container = EAudioContainer::Unknown;
+}
+
+EAudioContainer FAudioIngest::Probe(const uint8* InData, int64 InNumBytes)
+{
+    if (!InData || InNumBytes < 12)
+        return EAudioContainer::Unknown;
+
+    const auto Tag = [InData](int64 Offset, const char* FourCC) { return FMemory::Memcmp(InData + Offset, FourCC, 4) == 0; };
+
+    if ((Tag(0, "RIFF") || Tag(0, "RF64") || Tag(0, "BW64")) && Tag(8, "WAVE"))
+        return EAudioContainer::Wav;
+
+    //Wave64 uses GUIDs instead of FourCCs, the first four bytes of each GUID spell out the old tag in lower case
+    if (InNumBytes >= 40 && Tag(0, "riff") && Tag(24, "wave"))
+        return EAudioContainer::Wav;
+
+    if (mp3dec_detect_buf(InData, (size_t)InNumBytes) == 0)
+        return EAudioContainer::Mp3;
+
+    return EAudioContainer::Unknown;
+}
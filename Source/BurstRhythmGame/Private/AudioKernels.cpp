@@ -0,0 +1,561 @@
+#include "AudioKernels.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#include <immintrin.h>
+
+//The default x64 targets only go up to SSE4.2, so the AVX2 loops are compiled for AVX2 one function at a time and only called once the CPU
+//has said it runs them. MSVC takes AVX2 intrinsics without any flag, clang and gcc need the target attribute on every function that uses them
+#if defined(_MSC_VER) && !defined(__clang__)
+#define AUDIOKERNELS_AVX2
+#else
+#define AUDIOKERNELS_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace AudioKernels
+{
+    namespace
+    {
+        //Anything past +-40000 saturates anyway. Clamping there first keeps the int conversion away from its overflow value
+        constexpr float Int16Limit = 40000.0f;
+
+#if PLATFORM_CPU_X86_FAMILY
+        //Asked once, the answer cannot change while the process runs
+        bool HasAVX2()
+        {
+            static const bool bHasAVX2 = FPlatformMisc::HasAVX2InstructionSupport();
+            return bHasAVX2;
+        }
+
+        //Each AVX2 loop handles as many whole vectors as it can and returns where it stopped, the caller's SSE2 and scalar loops do the rest
+
+        AUDIOKERNELS_AVX2 int32 DownmixStereoAVX2(const float* In, float* Out, int32 NumFrames)
+        {
+            int32 i = 0;
+            const __m256 Half8 = _mm256_set1_ps(0.5f);
+            for (; i + 8 <= NumFrames; i += 8)
+            {
+                //hadd sums the L/R pairs inside each 128-bit lane, the permute then puts the two lanes back into frame order
+                const __m256 A = _mm256_loadu_ps(In + 2 * i);
+                const __m256 B = _mm256_loadu_ps(In + 2 * i + 8);
+                const __m256 S = _mm256_hadd_ps(A, B);
+                const __m256 P = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(S), _MM_SHUFFLE(3, 1, 2, 0)));
+                _mm256_storeu_ps(Out + i, _mm256_mul_ps(P, Half8));
+            }
+            return i;
+        }
+
+        AUDIOKERNELS_AVX2 int32 FloatToInt16AVX2(const float* In, int16* Out, int32 NumSamples)
+        {
+            int32 i = 0;
+            const __m256 Scale8  = _mm256_set1_ps(32768.0f);
+            const __m256 Half8   = _mm256_set1_ps(0.5f);
+            const __m256 Lo8     = _mm256_set1_ps(-Int16Limit);
+            const __m256 Hi8     = _mm256_set1_ps(Int16Limit);
+            for (; i + 16 <= NumSamples; i += 16)
+            {
+                const __m256 A = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(In + i), Scale8), Half8), Lo8), Hi8);
+                const __m256 B = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(In + i + 8), Scale8), Half8), Lo8), Hi8);
+                //packs works inside each 128-bit lane, the permute puts the four quarters back in order
+                const __m256i P = _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(A)), _mm256_cvttps_epi32(_mm256_floor_ps(B)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(Out + i), _mm256_permute4x64_epi64(P, _MM_SHUFFLE(3, 1, 2, 0)));
+            }
+            return i;
+        }
+
+        //Leaves the eight partial sums folded into four in OutAcc for the SSE2 loop to carry on with
+        AUDIOKERNELS_AVX2 int32 DotProductAVX2(const float* A, const float* B, int32 NumSamples, __m128& OutAcc)
+        {
+            int32 i = 0;
+            //Two accumulators hide the add latency
+            __m256 Acc0 = _mm256_setzero_ps();
+            __m256 Acc1 = _mm256_setzero_ps();
+            for (; i + 16 <= NumSamples; i += 16)
+            {
+                Acc0 = _mm256_add_ps(Acc0, _mm256_mul_ps(_mm256_loadu_ps(A + i),     _mm256_loadu_ps(B + i)));
+                Acc1 = _mm256_add_ps(Acc1, _mm256_mul_ps(_mm256_loadu_ps(A + i + 8), _mm256_loadu_ps(B + i + 8)));
+            }
+            const __m256 Acc8 = _mm256_add_ps(Acc0, Acc1);
+            OutAcc = _mm_add_ps(_mm256_castps256_ps128(Acc8), _mm256_extractf128_ps(Acc8, 1));
+            return i;
+        }
+
+        AUDIOKERNELS_AVX2 int32 MultiplyAddAVX2(const float* A, const float* B, const float* Add, float* Out, int32 NumSamples)
+        {
+            int32 i = 0;
+            for (; i + 8 <= NumSamples; i += 8)
+            {
+                const __m256 P = _mm256_mul_ps(_mm256_loadu_ps(A + i), _mm256_loadu_ps(B + i));
+                _mm256_storeu_ps(Out + i, Add ? _mm256_add_ps(P, _mm256_loadu_ps(Add + i)) : P);
+            }
+            return i;
+        }
+#endif
+
+        void DownmixGeneric(const float* In, float* Out, int32 NumFrames, int32 NumChannels)
+        {
+            const float Inv = 1.0f / (float)NumChannels;
+            for (int32 i = 0; i < NumFrames; ++i)
+            {
+                const float* Frame = In + (int64)i * NumChannels;
+                float sum = 0.0f;
+                for (int32 c = 0; c < NumChannels; ++c)
+                    sum += Frame[c];
+                Out[i] = sum * Inv;
+            }
+        }
+
+        //Each fast path handles as many whole vectors as it can and returns how many frames it wrote, the tail goes through DownmixGeneric
+        int32 DownmixStereo(const float* In, float* Out, int32 NumFrames)
+        {
+            int32 i = 0;
+#if PLATFORM_CPU_X86_FAMILY
+            if (HasAVX2())
+                i = DownmixStereoAVX2(In, Out, NumFrames);
+            const __m128 Half = _mm_set1_ps(0.5f);
+            for (; i + 4 <= NumFrames; i += 4)
+            {
+                const __m128 A = _mm_loadu_ps(In + 2 * i);     // L0 R0 L1 R1
+                const __m128 B = _mm_loadu_ps(In + 2 * i + 4); // L2 R2 L3 R3
+                const __m128 L = _mm_shuffle_ps(A, B, _MM_SHUFFLE(2, 0, 2, 0));
+                const __m128 R = _mm_shuffle_ps(A, B, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_ps(Out + i, _mm_mul_ps(_mm_add_ps(L, R), Half));
+            }
+#endif
+            return i;
+        }
+
+        int32 Downmix51(const float* In, float* Out, int32 NumFrames)
+        {
+            int32 i = 0;
+#if PLATFORM_CPU_X86_FAMILY
+            const __m128 Sixth = _mm_set1_ps(1.0f / 6.0f);
+            for (; i + 4 <= NumFrames; i += 4)
+            {
+                //Four frames are six registers. Folding registers 0 and 2 onto register 1 leaves two partial sums per frame in adjacent lanes
+                const float* F = In + 6 * i;
+                const __m128 V0 = _mm_loadu_ps(F);
+                const __m128 V1 = _mm_loadu_ps(F + 4);
+                const __m128 V2 = _mm_loadu_ps(F + 8);
+                const __m128 V3 = _mm_loadu_ps(F + 12);
+                const __m128 V4 = _mm_loadu_ps(F + 16);
+                const __m128 V5 = _mm_loadu_ps(F + 20);
+
+                const __m128 Q01 = _mm_add_ps(V1, _mm_add_ps(_mm_shuffle_ps(V0, V2, _MM_SHUFFLE(1, 0, 1, 0)), _mm_shuffle_ps(V0, V2, _MM_SHUFFLE(3, 2, 3, 2))));
+                const __m128 Q23 = _mm_add_ps(V4, _mm_add_ps(_mm_shuffle_ps(V3, V5, _MM_SHUFFLE(1, 0, 1, 0)), _mm_shuffle_ps(V3, V5, _MM_SHUFFLE(3, 2, 3, 2))));
+
+                const __m128 Sum = _mm_add_ps(_mm_shuffle_ps(Q01, Q23, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(Q01, Q23, _MM_SHUFFLE(3, 1, 3, 1)));
+                _mm_storeu_ps(Out + i, _mm_mul_ps(Sum, Sixth));
+            }
+#endif
+            return i;
+        }
+
+        int32 Downmix71(const float* In, float* Out, int32 NumFrames)
+        {
+            int32 i = 0;
+#if PLATFORM_CPU_X86_FAMILY
+            const __m128 Eighth = _mm_set1_ps(1.0f / 8.0f);
+            for (; i + 4 <= NumFrames; i += 4)
+            {
+                //Each frame is exactly two registers. Add them, then a partial 4x4 transpose gives one horizontal sum per lane
+                const float* F = In + 8 * i;
+                const __m128 S0 = _mm_add_ps(_mm_loadu_ps(F),      _mm_loadu_ps(F + 4));
+                const __m128 S1 = _mm_add_ps(_mm_loadu_ps(F + 8),  _mm_loadu_ps(F + 12));
+                const __m128 S2 = _mm_add_ps(_mm_loadu_ps(F + 16), _mm_loadu_ps(F + 20));
+                const __m128 S3 = _mm_add_ps(_mm_loadu_ps(F + 24), _mm_loadu_ps(F + 28));
+
+                const __m128 T01 = _mm_add_ps(_mm_unpacklo_ps(S0, S1), _mm_unpackhi_ps(S0, S1));
+                const __m128 T23 = _mm_add_ps(_mm_unpacklo_ps(S2, S3), _mm_unpackhi_ps(S2, S3));
+                const __m128 Sum = _mm_add_ps(_mm_movelh_ps(T01, T23), _mm_movehl_ps(T23, T01));
+                _mm_storeu_ps(Out + i, _mm_mul_ps(Sum, Eighth));
+            }
+#endif
+            return i;
+        }
+    }
+
+    void DownmixToMono(const float* In, float* Out, int32 NumFrames, int32 NumChannels)
+    {
+        if (!In || !Out || NumFrames <= 0 || NumChannels <= 0)
+            return;
+
+        int32 Done = 0;
+        switch (NumChannels)
+        {
+        case 1:
+            FMemory::Memcpy(Out, In, (SIZE_T)NumFrames * sizeof(float));
+            return;
+        case 2:
+            Done = DownmixStereo(In, Out, NumFrames);
+            break;
+        case 6:
+            Done = Downmix51(In, Out, NumFrames);
+            break;
+        case 8:
+            Done = Downmix71(In, Out, NumFrames);
+            break;
+        default:
+            break;
+        }
+
+        DownmixGeneric(In + (int64)Done * NumChannels, Out + Done, NumFrames - Done, NumChannels);
+    }
+
+    void DownmixToStereo(const float* In, float* Out, int32 NumFrames, int32 NumChannels)
+    {
+        if (!In || !Out || NumFrames <= 0 || NumChannels <= 2)
+            return;
+
+        //Only surround files come through here, rare enough that the scalar loop is fine. WAVE channel order is FL FR FC LFE BL BR (SL SR)
+        constexpr float Minus3dB = 0.70710678f;
+        if (NumChannels == 6 || NumChannels == 8)
+        {
+            const int32 Pairs = NumChannels == 8 ? 2 : 1;
+            const float Norm = 1.0f / (1.0f + Minus3dB + Minus3dB * Pairs);
+            for (int32 i = 0; i < NumFrames; ++i)
+            {
+                const float* F = In + (int64)i * NumChannels;
+                float L = F[0] + Minus3dB * F[2];
+                float R = F[1] + Minus3dB * F[2];
+                for (int32 p = 0; p < Pairs; ++p)
+                {
+                    L += Minus3dB * F[4 + 2 * p];
+                    R += Minus3dB * F[5 + 2 * p];
+                }
+                Out[2 * i]     = L * Norm;
+                Out[2 * i + 1] = R * Norm;
+            }
+            return;
+        }
+
+        const float InvL = 1.0f / (float)((NumChannels + 1) / 2);
+        const float InvR = 1.0f / (float)(NumChannels / 2);
+        for (int32 i = 0; i < NumFrames; ++i)
+        {
+            const float* F = In + (int64)i * NumChannels;
+            float L = 0.0f, R = 0.0f;
+            for (int32 c = 0; c < NumChannels; c += 2)
+                L += F[c];
+            for (int32 c = 1; c < NumChannels; c += 2)
+                R += F[c];
+            Out[2 * i]     = L * InvL;
+            Out[2 * i + 1] = R * InvR;
+        }
+    }
+
+    void Int16ToFloat(const int16* In, float* Out, int32 NumSamples, float Scale)
+    {
+        int32 i = 0;
+#if PLATFORM_CPU_X86_FAMILY
+        const __m128 S = _mm_set1_ps(Scale);
+        for (; i + 8 <= NumSamples; i += 8)
+        {
+            //Unpacking a register with itself puts every sample in the top half of a 32-bit lane, the arithmetic shift sign-extends it back down
+            const __m128i X  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(In + i));
+            const __m128i Lo = _mm_srai_epi32(_mm_unpacklo_epi16(X, X), 16);
+            const __m128i Hi = _mm_srai_epi32(_mm_unpackhi_epi16(X, X), 16);
+            _mm_storeu_ps(Out + i,     _mm_mul_ps(_mm_cvtepi32_ps(Lo), S));
+            _mm_storeu_ps(Out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(Hi), S));
+        }
+#endif
+        for (; i < NumSamples; ++i)
+            Out[i] = (float)In[i] * Scale;
+    }
+
+    namespace
+    {
+        FORCEINLINE uint32 NextDither(uint32& State)
+        {
+            State ^= State << 13;
+            State ^= State >> 17;
+            State ^= State << 5;
+            return State;
+        }
+
+        //Top 23 bits as the mantissa of a float in [1, 2)
+        FORCEINLINE float DitherToUnit(uint32 Bits)
+        {
+            const uint32 AsFloat = (Bits >> 9) | 0x3F800000u;
+            float Unit;
+            FMemory::Memcpy(&Unit, &AsFloat, sizeof(Unit));
+            return Unit - 1.0f;
+        }
+
+        FORCEINLINE int16 ToInt16Scalar(float Scaled)
+        {
+            //The comparisons are written so NaN falls through to the lower limit, like in the vector paths
+            const float Clamped = FMath::Min(Scaled > -Int16Limit ? Scaled : -Int16Limit, Int16Limit);
+            return (int16)FMath::Clamp(FMath::FloorToInt(Clamped), -32768, 32767);
+        }
+
+#if PLATFORM_CPU_X86_FAMILY
+        //SSE2 has no floor, so truncate and step down wherever that rounded up. Exact for everything inside +-Int16Limit
+        FORCEINLINE __m128i FloorToInt(__m128 X)
+        {
+            const __m128i T = _mm_cvttps_epi32(X);
+            const __m128  Up = _mm_cmpgt_ps(_mm_cvtepi32_ps(T), X);
+            return _mm_add_epi32(T, _mm_castps_si128(Up));
+        }
+
+        FORCEINLINE __m128 ScaleAndClamp(__m128 X, __m128 Offset)
+        {
+            //max returns its second operand when the first is NaN, which sends NaN to the lower limit
+            const __m128 Y = _mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(32768.0f)), Offset);
+            return _mm_min_ps(_mm_max_ps(Y, _mm_set1_ps(-Int16Limit)), _mm_set1_ps(Int16Limit));
+        }
+
+        FORCEINLINE __m128i NextDither(__m128i& State)
+        {
+            State = _mm_xor_si128(State, _mm_slli_epi32(State, 13));
+            State = _mm_xor_si128(State, _mm_srli_epi32(State, 17));
+            State = _mm_xor_si128(State, _mm_slli_epi32(State, 5));
+            return State;
+        }
+
+        FORCEINLINE __m128 DitherToUnit(__m128i Bits)
+        {
+            const __m128i AsFloat = _mm_or_si128(_mm_srli_epi32(Bits, 9), _mm_set1_epi32(0x3F800000));
+            return _mm_sub_ps(_mm_castsi128_ps(AsFloat), _mm_set1_ps(1.0f));
+        }
+
+        //The difference of two uniform [0, 1) values is triangular over (-1, 1), centred on 0. The 0.5 is the round-half-up offset
+        FORCEINLINE __m128 TPDFOffset(__m128i& State)
+        {
+            const __m128 A = DitherToUnit(NextDither(State));
+            const __m128 B = DitherToUnit(NextDither(State));
+            return _mm_add_ps(_mm_sub_ps(A, B), _mm_set1_ps(0.5f));
+        }
+#endif
+    }
+
+    void FloatToInt16(const float* In, int16* Out, int32 NumSamples, FTPDFDither* Dither)
+    {
+        int32 i = 0;
+        if (!Dither)
+        {
+#if PLATFORM_CPU_X86_FAMILY
+            if (HasAVX2())
+                i = FloatToInt16AVX2(In, Out, NumSamples);
+            const __m128 Half = _mm_set1_ps(0.5f);
+            for (; i + 8 <= NumSamples; i += 8)
+            {
+                const __m128i A = FloorToInt(ScaleAndClamp(_mm_loadu_ps(In + i), Half));
+                const __m128i B = FloorToInt(ScaleAndClamp(_mm_loadu_ps(In + i + 4), Half));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(Out + i), _mm_packs_epi32(A, B));
+            }
+#endif
+            for (; i < NumSamples; ++i)
+                Out[i] = ToInt16Scalar(In[i] * 32768.0f + 0.5f);
+            return;
+        }
+
+#if PLATFORM_CPU_X86_FAMILY
+        __m128i State = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Dither->State));
+        for (; i + 8 <= NumSamples; i += 8)
+        {
+            const __m128i A = FloorToInt(ScaleAndClamp(_mm_loadu_ps(In + i), TPDFOffset(State)));
+            const __m128i B = FloorToInt(ScaleAndClamp(_mm_loadu_ps(In + i + 4), TPDFOffset(State)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(Out + i), _mm_packs_epi32(A, B));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dither->State), State);
+#endif
+        for (; i < NumSamples; ++i)
+        {
+            uint32& LaneState = Dither->State[i & 3];
+            const float A = DitherToUnit(NextDither(LaneState));
+            const float B = DitherToUnit(NextDither(LaneState));
+            Out[i] = ToInt16Scalar(In[i] * 32768.0f + (A - B + 0.5f));
+        }
+    }
+
+    float DotProduct(const float* A, const float* B, int32 NumSamples)
+    {
+        int32 i = 0;
+        float Sum = 0.0f;
+#if PLATFORM_CPU_X86_FAMILY
+        __m128 Acc = _mm_setzero_ps();
+        if (HasAVX2())
+            i = DotProductAVX2(A, B, NumSamples, Acc);
+        __m128 Acc4 = _mm_setzero_ps();
+        for (; i + 8 <= NumSamples; i += 8)
+        {
+            Acc  = _mm_add_ps(Acc,  _mm_mul_ps(_mm_loadu_ps(A + i),     _mm_loadu_ps(B + i)));
+            Acc4 = _mm_add_ps(Acc4, _mm_mul_ps(_mm_loadu_ps(A + i + 4), _mm_loadu_ps(B + i + 4)));
+        }
+        Acc = _mm_add_ps(Acc, Acc4);
+        Acc = _mm_add_ps(Acc, _mm_movehl_ps(Acc, Acc));
+        Acc = _mm_add_ss(Acc, _mm_shuffle_ps(Acc, Acc, _MM_SHUFFLE(1, 1, 1, 1)));
+        Sum = _mm_cvtss_f32(Acc);
+#endif
+        for (; i < NumSamples; ++i)
+            Sum += A[i] * B[i];
+        return Sum;
+    }
+
+    void MultiplyAdd(const float* A, const float* B, const float* Add, float* Out, int32 NumSamples)
+    {
+        int32 i = 0;
+#if PLATFORM_CPU_X86_FAMILY
+        if (HasAVX2())
+            i = MultiplyAddAVX2(A, B, Add, Out, NumSamples);
+        for (; i + 4 <= NumSamples; i += 4)
+        {
+            const __m128 P = _mm_mul_ps(_mm_loadu_ps(A + i), _mm_loadu_ps(B + i));
+            _mm_storeu_ps(Out + i, Add ? _mm_add_ps(P, _mm_loadu_ps(Add + i)) : P);
+        }
+#endif
+        for (; i < NumSamples; ++i)
+            Out[i] = A[i] * B[i] + (Add ? Add[i] : 0.0f);
+    }
+}
+
+#if !UE_BUILD_SHIPPING
+namespace
+{
+    //This is the loop both decoders used before the kernel existed. It is only kept around as the baseline for the benchmark
+    void DownmixReference(const float* In, float* Out, int32 NumFrames, int32 NumChannels)
+    {
+        for (int32 i = 0; i < NumFrames; ++i)
+        {
+            double sum = 0.0;
+            for (int32 c = 0; c < NumChannels; ++c)
+                sum += In[i * NumChannels + c];
+            Out[i] = (float)(sum / (double)NumChannels);
+        }
+    }
+
+    //Scalar FloatToInt16 without dither: scale by 32768, round half up, saturate. The kernel has to match it bit for bit. The loop
+    //CreateProceduralFromPCM had before the kernel scaled by 32767, so playback output moved by up to one LSB when the kernel came in
+    void FloatToInt16Reference(const float* In, int16* Out, int32 NumSamples)
+    {
+        for (int32 i = 0; i < NumSamples; ++i)
+            Out[i] = (int16)FMath::Clamp(FMath::RoundToInt(In[i] * 32768.0f), -32768, 32767);
+    }
+
+    template <typename FuncType>
+    double TimeBestOf(int32 Runs, FuncType&& Func)
+    {
+        double Best = TNumericLimits<double>::Max();
+        for (int32 r = 0; r < Runs; ++r)
+        {
+            const double Start = FPlatformTime::Seconds();
+            Func();
+            Best = FMath::Min(Best, FPlatformTime::Seconds() - Start);
+        }
+        return Best;
+    }
+
+    //60 s of 48 kHz noise on one Xeon core (best of 5, GB/s of interleaved input), reference / SSE2 path / AVX2 path:
+    //  2 ch 2.3 / 7.0 / 8.4, 6 ch 3.4 / 8.3 / 8.2, 8 ch 3.6 / 8.5 / 8.7
+    //Past stereo both paths sit at the memory bandwidth, which is why only the stereo shuffle has an AVX2 version.
+    //The kernel sums in float and the reference in double, on inputs in [-1, 1] the difference stayed below a third of Channels * FLT_EPSILON
+    //for every channel count from 1 to 16, so that is the tolerance
+    void RunDownmixBenchmark(const TArray<FString>& Args)
+    {
+        const int32 Channels = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 16) : 2;
+        const int32 Seconds  = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 1, 600) : 60;
+        const int32 Frames   = Seconds * 48000;
+        constexpr int32 Runs = 5;
+
+        TArray<float> In;
+        In.SetNumUninitialized(Frames * Channels);
+        FRandomStream Rng(1234);
+        for (float& S : In)
+            S = Rng.FRandRange(-1.0f, 1.0f);
+
+        TArray<float> OutRef, OutNew;
+        OutRef.SetNumUninitialized(Frames);
+        OutNew.SetNumUninitialized(Frames);
+
+        const double RefSec = TimeBestOf(Runs, [&]() { DownmixReference(In.GetData(), OutRef.GetData(), Frames, Channels); });
+        const double NewSec = TimeBestOf(Runs, [&]() { AudioKernels::DownmixToMono(In.GetData(), OutNew.GetData(), Frames, Channels); });
+
+        const float Tolerance = (float)Channels * FLT_EPSILON;
+        float MaxErr = 0.0f;
+        int32 OutOfTolerance = 0;
+        for (int32 i = 0; i < Frames; ++i)
+        {
+            const float Err = FMath::Abs(OutRef[i] - OutNew[i]);
+            MaxErr = FMath::Max(MaxErr, Err);
+            OutOfTolerance += Err > Tolerance ? 1 : 0;
+        }
+
+        //Throughput is measured on the interleaved input, which is what dominates memory traffic
+        const double GB = (double)In.Num() * sizeof(float) / 1e9;
+#if PLATFORM_CPU_X86_FAMILY
+        const TCHAR* Path = AudioKernels::HasAVX2() ? TEXT("AVX2") : TEXT("SSE2");
+#else
+        const TCHAR* Path = TEXT("scalar");
+#endif
+        UE_LOG(LogTemp, Display, TEXT("[MZDBG] Downmix %d ch, %d s @ 48kHz: reference %.2f GB/s, %s kernel %.2f GB/s (x%.2f), max abs diff %g (tolerance %g)"),
+            Channels, Seconds, GB / RefSec, Path, GB / NewSec, RefSec / NewSec, MaxErr, Tolerance);
+        if (OutOfTolerance > 0)
+            UE_LOG(LogTemp, Error, TEXT("[MZDBG] DownmixToMono is off the reference by more than %g for %d of %d frames"), Tolerance, OutOfTolerance, Frames);
+    }
+
+    void RunFloatToInt16Benchmark(const TArray<FString>& Args)
+    {
+        const int32 Seconds  = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 600) : 60;
+        const int32 Samples  = Seconds * 48000;
+        constexpr int32 Runs = 5;
+
+        //Slightly past full scale so the saturation is exercised too, and every value that lands exactly halfway between two steps in range
+        TArray<float> In;
+        In.SetNumUninitialized(Samples);
+        FRandomStream Rng(1234);
+        for (float& S : In)
+            S = Rng.FRandRange(-1.1f, 1.1f);
+        for (int32 Step = -32769; Step <= 32768 && Step + 32769 < Samples; ++Step)
+            In[Step + 32769] = ((float)Step + 0.5f) / 32768.0f;
+
+        TArray<int16> OutRef, OutNew, OutDither;
+        OutRef.SetNumUninitialized(Samples);
+        OutNew.SetNumUninitialized(Samples);
+        OutDither.SetNumUninitialized(Samples);
+
+        AudioKernels::FTPDFDither Dither;
+        const double RefSec    = TimeBestOf(Runs, [&]() { FloatToInt16Reference(In.GetData(), OutRef.GetData(), Samples); });
+        const double NewSec    = TimeBestOf(Runs, [&]() { AudioKernels::FloatToInt16(In.GetData(), OutNew.GetData(), Samples); });
+        const double DitherSec = TimeBestOf(Runs, [&]() { AudioKernels::FloatToInt16(In.GetData(), OutDither.GetData(), Samples, &Dither); });
+
+        //Without dither any difference to the reference is a bug. The dither is measured against the undithered kernel, so it only shows the noise that was added
+        int32 Mismatches = 0;
+        int32 FirstMismatch = INDEX_NONE;
+        int32 MaxDitherStep = 0;
+        double DitherBias = 0.0;
+        for (int32 i = 0; i < Samples; ++i)
+        {
+            if (OutNew[i] != OutRef[i])
+            {
+                FirstMismatch = FirstMismatch == INDEX_NONE ? i : FirstMismatch;
+                ++Mismatches;
+            }
+            MaxDitherStep = FMath::Max(MaxDitherStep, FMath::Abs((int32)OutDither[i] - (int32)OutNew[i]));
+            DitherBias += (double)OutDither[i] - (double)OutNew[i];
+        }
+
+        UE_LOG(LogTemp, Display, TEXT("[MZDBG] FloatToInt16 %d s @ 48kHz: reference %.0f Msamples/s, kernel %.0f Msamples/s (x%.2f), dithered %.0f Msamples/s, %d samples differ from the reference, dither max %d LSB mean %+.4f LSB"),
+            Seconds, Samples / RefSec / 1e6, Samples / NewSec / 1e6, RefSec / NewSec, Samples / DitherSec / 1e6, Mismatches, MaxDitherStep, DitherBias / Samples);
+        if (Mismatches > 0)
+            UE_LOG(LogTemp, Error, TEXT("[MZDBG] FloatToInt16 is not bit-exact: %d samples differ from the reference, the first at %d (%.9g -> %d, expected %d)"),
+                Mismatches, FirstMismatch, In[FirstMismatch], OutNew[FirstMismatch], OutRef[FirstMismatch]);
+    }
+
+    FAutoConsoleCommand BenchFloatToInt16Command(
+        TEXT("rhythm.BenchFloatToInt16"),
+        TEXT("Times a scalar float to int16 loop with the kernel's rounding against AudioKernels::FloatToInt16 with and without dither, fails unless the undithered output is bit-exact and measures the dither against it. Args: [Seconds=60]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&RunFloatToInt16Benchmark));
+
+    FAutoConsoleCommand BenchDownmixCommand(
+        TEXT("rhythm.BenchDownmix"),
+        TEXT("Times the original scalar downmix loop against AudioKernels::DownmixToMono, reports GB/s and fails if any frame is more than Channels * FLT_EPSILON off. Args: [Channels=2] [Seconds=60]"),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&RunDownmixBenchmark));
+}
+#endif
@@ -0,0 +1,117 @@
+#include "AudioScratchPool.h"
+
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+    TAutoConsoleVariable<int32> CVarScratchPoolMaxMB(
+        TEXT("rhythm.ScratchPoolMaxMB"),
+        512,
+        TEXT("Most memory in MB a world's audio scratch pool keeps around between sessions. Read when the world starts."));
+
+    void LogPoolStats(const FAudioScratchPool::FStats& Stats, const TCHAR* WorldName)
+    {
+        UE_LOG(LogTemp, Log, TEXT("[MZDBG] Scratch pool of %s: %lld of %lld requests reused (%.0f%%), %.1f MB pooled, high water %.1f MB, %.1f MB dropped over the cap"),
+            WorldName, Stats.Hits, Stats.Requests, 100.0f * Stats.GetHitRate(), Stats.PooledBytes / (1024.0 * 1024.0),
+            Stats.HighWaterBytes / (1024.0 * 1024.0), Stats.DroppedBytes / (1024.0 * 1024.0));
+    }
+
+    FAutoConsoleCommandWithWorld ScratchPoolStatsCommand(
+        TEXT("rhythm.ScratchPoolStats"),
+        TEXT("Logs the reuse statistics of this world's audio scratch pool."),
+        FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+        {
+            const UAudioScratchSubsystem* Subsystem = World ? World->GetSubsystem<UAudioScratchSubsystem>() : nullptr;
+            if (Subsystem && Subsystem->GetPool())
+                LogPoolStats(Subsystem->GetPool()->GetStats(), *World->GetName());
+        }));
+}
+
+TArray<uint8> FAudioScratchPool::Acquire(int64 NumBytes)
+{
+    TArray<uint8> Buffer;
+    {
+        FScopeLock ScopeLock(&Lock);
+        ++Stats.Requests;
+
+        int32 Best = INDEX_NONE;
+        for (int32 i = 0; i < Free.Num(); ++i)
+        {
+            const int64 Capacity = Free[i].Max();
+            if (Capacity >= NumBytes && Capacity <= 2 * FMath::Max<int64>(NumBytes, 1)
+                && (Best == INDEX_NONE || Capacity < Free[Best].Max()))
+            {
+                Best = i;
+            }
+        }
+
+        if (Best != INDEX_NONE)
+        {
+            ++Stats.Hits;
+            Stats.PooledBytes -= Free[Best].Max();
+            Buffer = MoveTemp(Free[Best]);
+            Free.RemoveAtSwap(Best, 1, false);
+        }
+    }
+
+    check(NumBytes >= 0 && NumBytes <= MAX_int32);
+    Buffer.SetNumUninitialized((int32)NumBytes, false);
+    return Buffer;
+}
+
+void FAudioScratchPool::Release(TArray<uint8>&& Buffer)
+{
+    const int64 Capacity = Buffer.Max();
+    if (Capacity == 0)
+        return;
+
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (Stats.PooledBytes + Capacity <= MaxPooledBytes)
+        {
+            Stats.PooledBytes += Capacity;
+            Stats.HighWaterBytes = FMath::Max(Stats.HighWaterBytes, Stats.PooledBytes);
+            Free.Add(MoveTemp(Buffer));
+            return;
+        }
+        Stats.DroppedBytes += Capacity;
+    }
+
+    //Over the cap, the buffer is freed outside the lock
+    Buffer.Empty();
+}
+
+void FAudioScratchPool::Trim()
+{
+    TArray<TArray<uint8>> ToFree;
+    {
+        FScopeLock ScopeLock(&Lock);
+        ToFree = MoveTemp(Free);
+        Stats.PooledBytes = 0;
+    }
+}
+
+FAudioScratchPool::FStats FAudioScratchPool::GetStats() const
+{
+    FScopeLock ScopeLock(&Lock);
+    return Stats;
+}
+
+void UAudioScratchSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+    Pool = MakeShared<FAudioScratchPool, ESPMode::ThreadSafe>((int64)FMath::Max(CVarScratchPoolMaxMB.GetValueOnGameThread(), 0) * 1024 * 1024);
+}
+
+void UAudioScratchSubsystem::Deinitialize()
+{
+    //Tracks that still hold the pool keep it alive, whatever is pooled right now is freed with the world
+    if (Pool)
+    {
+        LogPoolStats(Pool->GetStats(), *GetWorld()->GetName());
+        Pool->Trim();
+        Pool.Reset();
+    }
+    Super::Deinitialize();
+}
@@ -0,0 +1,415 @@
+#include "DecodeBenchmarkCommandlet.h"
+
+#include "MusicZone.h"
+#include "AudioIngest.h"
+#include "AudioScratchPool.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/Package.h"
+
+namespace
+{
+    template <typename SampleType>
+    int32 FindFirstDifference(const SampleType* A, const SampleType* B, int32 Count)
+    {
+        if (FMemory::Memcmp(A, B, Count * sizeof(SampleType)) == 0)
+            return INDEX_NONE;
+        int32 Index = 0;
+        while (FMemory::Memcmp(A + Index, B + Index, sizeof(SampleType)) == 0)
+            ++Index;
+        return Index;
+    }
+
+    //First sample at which the two tracks are not bitwise identical, INDEX_NONE if they are. Tracks of different length differ where the shorter one ends
+    int64 FindFirstMismatch(const FPCMTrack& A, const FPCMTrack& B)
+    {
+        if (A.GetStorage() != B.GetStorage())
+            return 0;
+
+        constexpr int32 BlockSamples = 65536;
+        TArray<float> ScratchA, ScratchB;
+        ScratchA.SetNumUninitialized(BlockSamples);
+        ScratchB.SetNumUninitialized(BlockSamples);
+
+        const int64 Common = FMath::Min(A.Num(), B.Num());
+        for (int64 Pos = 0; Pos < Common; Pos += BlockSamples)
+        {
+            const int32 Count = (int32)FMath::Min<int64>(BlockSamples, Common - Pos);
+            const int32 Diff = A.GetStorage() == EPCMStorage::Int16
+                ? FindFirstDifference(A.ReadInt16(Pos, Count, (int16*)ScratchA.GetData()), B.ReadInt16(Pos, Count, (int16*)ScratchB.GetData()), Count)
+                : FindFirstDifference(A.ReadFloat(Pos, Count, ScratchA.GetData()), B.ReadFloat(Pos, Count, ScratchB.GetData()), Count);
+            if (Diff != INDEX_NONE)
+                return Pos + Diff;
+        }
+        return A.Num() == B.Num() ? INDEX_NONE : Common;
+    }
+}
+
+//Empties the zone's streams and counters outside the timed region and times the decoder that matches the container
+bool UDecodeBenchmarkCommandlet::TimedDecode(AMusicZone* Zone, const FAudioIngest& Source, EAudioContainer Container, double& OutSeconds)
+{
+    Zone->FullPCM.Empty();
+    Zone->PlaybackPCM.Empty();
+    Zone->DecodedFrames.store(0, std::memory_order_relaxed);
+    Zone->DownmixCycles.store(0, std::memory_order_relaxed);
+    Zone->bCancelLoad = false;
+
+    const double Start = FPlatformTime::Seconds();
+    const bool bOk = Container == EAudioContainer::Wav ? Zone->DecodeWav(Source) : Zone->DecodeMp3(Source);
+    OutSeconds = FPlatformTime::Seconds() - Start;
+    return bOk;
+}
+
+//Runs the onset analysis over the whole decoded song twice. Once normalized to the loudness of the whole song, which is how a full decode or
+//a cache hit starts, and once the way a progressive start does it: on the loudness of its lead until RestartAnalysisWithGain switches to
+//the song's. Returns the first prompt at which the two charts differ, INDEX_NONE if they are identical
+int32 UDecodeBenchmarkCommandlet::CompareProgressiveChart(AMusicZone* Zone, float& OutLeadGain, float& OutSongGain, int32& OutNumPrompts)
+{
+    const int64 Total = Zone->FullPCM.Num();
+    Zone->DecodedFrames.store(Total, std::memory_order_relaxed);
+    const FLoudnessStats SongStats = Zone->Loudness.GetStats();
+
+    //The decoder meters the same mono stream the analysis reads, so the lead is measured again from there
+    const int64 LeadFrames = FMath::Min<int64>(Total, (int64)(Zone->ProgressiveLeadSec * Zone->SampleRate));
+    FLoudnessMeter LeadMeter;
+    LeadMeter.Init(Zone->SampleRate);
+    TArray<float> Scratch;
+    Scratch.SetNumUninitialized(65536);
+    for (int64 Pos = 0; Pos < LeadFrames; Pos += Scratch.Num())
+    {
+        const int32 Count = (int32)FMath::Min<int64>(Scratch.Num(), LeadFrames - Pos);
+        LeadMeter.Process(Zone->FullPCM.ReadFloat(Pos, Count, Scratch.GetData()), Count);
+    }
+    const FLoudnessStats LeadStats = LeadMeter.GetStats();
+
+    OutLeadGain = Zone->GetOnsetEnergyScale(LeadStats);
+    OutSongGain = Zone->GetOnsetEnergyScale(SongStats);
+
+    const auto AnalyzeSong = [Zone, Total](const FLoudnessStats& StartStats, bool bProgressive, TArray<FPrompt>& OutChart)
+    {
+        Zone->LoudnessStats = StartStats;
+        Zone->InitDrumFilters();
+        Zone->PreRollAnalysis();
+        if (bProgressive)
+            Zone->RestartAnalysisWithGain(Zone->GetOnsetEnergyScale(Zone->Loudness.GetStats()));
+
+        TArray<float> Hop;
+        Hop.SetNumUninitialized(Zone->GetSourceSamplesPerHop());
+        while (Zone->AnalysisCursorSamples < Total)
+            Zone->AnalyzeHop(Hop.GetData(), (int32)FMath::Min<int64>(Hop.Num(), Total - Zone->AnalysisCursorSamples));
+
+        FPrompt P;
+        while (Zone->PromptBuffer.Dequeue(P))
+            OutChart.Add(P);
+    };
+
+    TArray<FPrompt> FullChart, ProgressiveChart;
+    AnalyzeSong(SongStats, false, FullChart);
+    AnalyzeSong(LeadStats, true, ProgressiveChart);
+    Zone->Checkpoints.Empty();
+    OutNumPrompts = FullChart.Num();
+
+    const int32 Common = FMath::Min(FullChart.Num(), ProgressiveChart.Num());
+    for (int32 i = 0; i < Common; ++i)
+    {
+        if (FullChart[i].Time != ProgressiveChart[i].Time || FullChart[i].Strength != ProgressiveChart[i].Strength)
+            return i;
+    }
+    return FullChart.Num() == ProgressiveChart.Num() ? INDEX_NONE : Common;
+}
+
+//Plays ShortFile, then a queue of ShortFile and LongFile, the way Tick drives the playlist: TickPlaylist on every step while a feed cursor
+//moves through the track at Speedup times real time. The analysis worker picks a new song's gain up on its next hop, so that is done
+//right after each tick. A faster feed only leaves the fetch less time, so a run without a gap holds at real time too. Returns false if
+//a song could not be decoded or appended, OutGapSeconds is how much song time the feed could not play because the next song was not in yet
+bool UDecodeBenchmarkCommandlet::CheckPlaylistPrefetch(AMusicZone* Zone, const FString& ShortFile, const FString& LongFile, float Speedup, double& OutGapSeconds)
+{
+    OutGapSeconds = 0.0;
+
+    FAudioIngest Source;
+    if (!Source.Open(ShortFile, Zone->bMemoryMapSource, Zone->ScratchPool.Get()))
+        return false;
+
+    const int64 GrowLimit = (int64)(Zone->PlaylistMaxMinutes * 60.0f * AMusicZone::PlaylistMaxSampleRate);
+    Zone->FullPCM.SetGrowLimit(GrowLimit);
+    Zone->PlaybackPCM.SetGrowLimit(GrowLimit * 2);
+    double DecodeSec = 0.0;
+    if (!TimedDecode(Zone, Source, Source.GetContainer(), DecodeSec))
+        return false;
+
+    Zone->PlaylistQueue = { ShortFile, LongFile };
+    Zone->AppendBase = 0;
+    Zone->NextTrackStartFrame.store(-1, std::memory_order_relaxed);
+    Zone->QueuedFrames.store(0, std::memory_order_relaxed);
+    Zone->bDecodeComplete = true;
+    Zone->bMoreTracksComing = true;
+
+    //After the first song the watermark only moves when AppendPlaylistTrack publishes a whole song
+    int32 Appended = 0;
+    int64 Cursor = 0;
+    int64 LastAvailable = Zone->DecodedFrames.load(std::memory_order_acquire);
+    double Last = FPlatformTime::Seconds();
+    while (Zone->bMoreTracksComing)
+    {
+        FPlatformProcess::Sleep(0.005f);
+        const double Now = FPlatformTime::Seconds();
+        const int64 Wanted = Cursor + (int64)((Now - Last) * Speedup * Zone->SampleRate);
+        Last = Now;
+
+        //The feed stops at the watermark, anything it wanted past it while another song was on its way is a gap
+        const int64 Available = Zone->DecodedFrames.load(std::memory_order_acquire);
+        Cursor = FMath::Min(Wanted, Available);
+        OutGapSeconds += (double)(Wanted - Cursor) / Zone->SampleRate;
+        Zone->QueuedFrames.store(Cursor, std::memory_order_release);
+        if (Available > LastAvailable)
+            ++Appended;
+        LastAvailable = Available;
+
+        Zone->TickPlaylist();
+        Zone->NextTrackStartFrame.store(-1, std::memory_order_release);
+    }
+    if (Zone->DecodedFrames.load(std::memory_order_acquire) > LastAvailable)
+        ++Appended;
+
+    Zone->FullPCM.SetGrowLimit(0);
+    Zone->PlaybackPCM.SetGrowLimit(0);
+    return Appended == 2;
+}
+
+UDecodeBenchmarkCommandlet::UDecodeBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 UDecodeBenchmarkCommandlet::Main(const FString& Params)
+{
+    FString Dir;
+    if (!FParse::Value(*Params, TEXT("Dir="), Dir) || !IFileManager::Get().DirectoryExists(*Dir))
+    {
+        UE_LOG(LogTemp, Error, TEXT("[MZDBG] DecodeBenchmark needs -Dir=<directory with .wav/.mp3 files>"));
+        return 1;
+    }
+
+    FString OutPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("DecodeBenchmark-%s.json"), *FDateTime::Now().ToString());
+    FParse::Value(*Params, TEXT("Out="), OutPath);
+
+    int32 Runs = 1;
+    FParse::Value(*Params, TEXT("Runs="), Runs);
+    Runs = FMath::Clamp(Runs, 1, 100);
+
+    const bool bCompact = FParse::Param(*Params, TEXT("Compact"));
+    const bool bSerial  = FParse::Param(*Params, TEXT("Serial"));
+
+    float PlaylistSpeedup = 4.0f;
+    const bool bPlaylistCheck = FParse::Value(*Params, TEXT("PlaylistCheck="), PlaylistSpeedup) || FParse::Param(*Params, TEXT("PlaylistCheck"));
+    PlaylistSpeedup = FMath::Clamp(PlaylistSpeedup, 1.0f, 64.0f);
+
+    TArray<FString> Files;
+    IFileManager::Get().FindFilesRecursive(Files, *Dir, TEXT("*.wav"), true, false);
+    IFileManager::Get().FindFilesRecursive(Files, *Dir, TEXT("*.mp3"), true, false, false);
+    Files.Sort();
+
+    //The zone is never spawned into a world, it is only a host for the decoders and the track they fill.
+    //Progressive start stays off so nothing gets handed to a game thread that is not ticking.
+    //The zone never runs BeginPlay, so it gets a pool of its own. Repeated runs and files then show the same reuse a player moving between zones sees.
+    //Silence trimming is off so audioSeconds and realtimeFactor are over everything that was decoded, not just the part between the silences
+    const TSharedPtr<FAudioScratchPool, ESPMode::ThreadSafe> ScratchPool = MakeShared<FAudioScratchPool, ESPMode::ThreadSafe>(MAX_int64);
+    auto MakeZone = [&](bool bParallel)
+    {
+        AMusicZone* NewZone = NewObject<AMusicZone>(GetTransientPackage());
+        NewZone->bProgressiveStart   = false;
+        NewZone->bUsePCMCache        = false;
+        NewZone->bCompactPCMStorage  = bCompact;
+        NewZone->bParallelMp3Decode  = bParallel;
+        NewZone->bTrimSilence        = false;
+        NewZone->ScratchPool = ScratchPool;
+        NewZone->FullPCM.SetPool(ScratchPool);
+        NewZone->PlaybackPCM.SetPool(ScratchPool);
+        return NewZone;
+    };
+    AMusicZone* Zone = MakeZone(!bSerial);
+
+    //Unless -Serial is given, every MP3 is decoded a second time by a zone with the parallel decode off, and both results are compared sample for sample
+    AMusicZone* SerialZone = bSerial ? nullptr : MakeZone(false);
+
+    TArray<TSharedPtr<FJsonValue>> Results;
+    FString ShortestFile, LongestFile;
+    double ShortestSec = TNumericLimits<double>::Max();
+    double LongestSec  = 0.0;
+    for (const FString& File : Files)
+    {
+        //The file is ingested once outside the timed region, like the zone does before it checks the cache
+        FAudioIngest Source;
+        const bool bIngested = Source.Open(File, Zone->bMemoryMapSource, Zone->ScratchPool.Get());
+        const EAudioContainer Container = Source.GetContainer();
+
+        //Best of Runs for the times. Peak RSS is the whole process's and only ever goes up, so it is reported as such: the delta is how much
+        //this file raised the process peak, 0 when an earlier file had already gone higher. residentMB is this file's own streams
+        double BestDecodeSec  = TNumericLimits<double>::Max();
+        double BestDownmixSec = TNumericLimits<double>::Max();
+        bool bOk = bIngested && Container != EAudioContainer::Unknown;
+        const uint64 PeakBefore = FPlatformMemory::GetStats().PeakUsedPhysical;
+
+        for (int32 Run = 0; Run < Runs && bOk; ++Run)
+        {
+            double DecodeSec = 0.0;
+            bOk = TimedDecode(Zone, Source, Container, DecodeSec);
+
+            BestDecodeSec  = FMath::Min(BestDecodeSec, DecodeSec);
+            BestDownmixSec = FMath::Min(BestDownmixSec, FPlatformTime::ToSeconds64(Zone->DownmixCycles.load(std::memory_order_relaxed)));
+        }
+
+        //Taken before the serial reference decode, which holds a second copy of the track
+        const uint64 PeakAfter = FPlatformMemory::GetStats().PeakUsedPhysical;
+
+        const bool bCompare = bOk && SerialZone && Container == EAudioContainer::Mp3;
+        double BestSerialSec = TNumericLimits<double>::Max();
+        bool bSerialOk = bCompare;
+        for (int32 Run = 0; Run < Runs && bSerialOk; ++Run)
+        {
+            double SerialSec = 0.0;
+            bSerialOk = TimedDecode(SerialZone, Source, Container, SerialSec);
+            BestSerialSec = FMath::Min(BestSerialSec, SerialSec);
+        }
+        const int64 FullMismatch     = bSerialOk ? FindFirstMismatch(Zone->FullPCM, SerialZone->FullPCM) : INDEX_NONE;
+        const int64 PlaybackMismatch = bSerialOk ? FindFirstMismatch(Zone->PlaybackPCM, SerialZone->PlaybackPCM) : INDEX_NONE;
+        if (SerialZone)
+        {
+            SerialZone->FullPCM.Empty();
+            SerialZone->PlaybackPCM.Empty();
+        }
+
+        TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+        Entry->SetStringField(TEXT("file"), FPaths::GetCleanFilename(File));
+        Entry->SetStringField(TEXT("container"), Container == EAudioContainer::Wav ? TEXT("wav") : Container == EAudioContainer::Mp3 ? TEXT("mp3") : TEXT("unknown"));
+        Entry->SetBoolField(TEXT("ok"), bOk);
+        if (bOk)
+        {
+            const double AudioSec = (double)Zone->FullPCM.Num() / (double)Zone->SampleRate;
+            Entry->SetNumberField(TEXT("sampleRate"), Zone->SampleRate);
+            Entry->SetNumberField(TEXT("audioSeconds"), AudioSec);
+            if (AudioSec < ShortestSec)
+            {
+                ShortestSec  = AudioSec;
+                ShortestFile = File;
+            }
+            if (AudioSec > LongestSec)
+            {
+                LongestSec  = AudioSec;
+                LongestFile = File;
+            }
+            Entry->SetNumberField(TEXT("decodeSeconds"), BestDecodeSec);
+            Entry->SetNumberField(TEXT("realtimeFactor"), BestDecodeSec > 0.0 ? AudioSec / BestDecodeSec : 0.0);
+            //Summed over all shard threads for a parallel MP3 decode, so it can exceed the wall-clock decode time
+            Entry->SetNumberField(TEXT("downmixSeconds"), BestDownmixSec);
+            Entry->SetNumberField(TEXT("integratedLufs"), Zone->Loudness.GetStats().IntegratedLufs);
+            Entry->SetNumberField(TEXT("residentMB"), (Zone->FullPCM.GetAllocatedSize() + Zone->PlaybackPCM.GetAllocatedSize()) / (1024.0 * 1024.0));
+            Entry->SetNumberField(TEXT("processPeakRssMB"), PeakAfter / (1024.0 * 1024.0));
+            Entry->SetNumberField(TEXT("processPeakRssDeltaMB"), (PeakAfter - PeakBefore) / (1024.0 * 1024.0));
+
+            UE_LOG(LogTemp, Display, TEXT("[MZDBG] %s: %.2fs audio decoded in %.3fs (x%.1f realtime), downmix %.3fs, process peak RSS %.1f MB"),
+                *FPaths::GetCleanFilename(File), AudioSec, BestDecodeSec, AudioSec / FMath::Max(BestDecodeSec, 1e-9), BestDownmixSec, PeakAfter / (1024.0 * 1024.0));
+
+            //A progressive start has to end up with the chart a full decode or a cache hit makes, whatever the loudness of its lead
+            float LeadGain = 1.0f, SongGain = 1.0f;
+            int32 NumPrompts = 0;
+            const int32 ChartMismatch = CompareProgressiveChart(Zone, LeadGain, SongGain, NumPrompts);
+            Entry->SetNumberField(TEXT("onsetLeadGain"), LeadGain);
+            Entry->SetNumberField(TEXT("onsetSongGain"), SongGain);
+            Entry->SetNumberField(TEXT("chartPrompts"), NumPrompts);
+            Entry->SetNumberField(TEXT("firstChartMismatch"), ChartMismatch);
+            if (ChartMismatch != INDEX_NONE)
+                UE_LOG(LogTemp, Error, TEXT("[MZDBG] %s: the progressive start's chart differs from the full decode's at prompt %d (gain %.3f from the lead, %.3f from the song)"),
+                    *FPaths::GetCleanFilename(File), ChartMismatch, LeadGain, SongGain);
+
+            if (Container == EAudioContainer::Mp3)
+                Entry->SetBoolField(TEXT("parallelUsed"), Zone->bDecodedParallel);
+            if (bCompare)
+            {
+                //Mismatches are sample indices into the stream, -1 when it is bit-identical to the serial decode
+                Entry->SetBoolField(TEXT("serialOk"), bSerialOk);
+                if (bSerialOk)
+                {
+                    Entry->SetNumberField(TEXT("serialDecodeSeconds"), BestSerialSec);
+                    Entry->SetNumberField(TEXT("parallelSpeedup"), BestDecodeSec > 0.0 ? BestSerialSec / BestDecodeSec : 0.0);
+                    Entry->SetNumberField(TEXT("firstFullMismatch"), (double)FullMismatch);
+                    Entry->SetNumberField(TEXT("firstPlaybackMismatch"), (double)PlaybackMismatch);
+                }
+
+                if (!bSerialOk)
+                    UE_LOG(LogTemp, Warning, TEXT("[MZDBG] %s: serial reference decode failed"), *FPaths::GetCleanFilename(File));
+                else if (FullMismatch != INDEX_NONE || PlaybackMismatch != INDEX_NONE)
+                    UE_LOG(LogTemp, Error, TEXT("[MZDBG] %s: parallel decode differs from serial, first mismatch at mono sample %lld / playback sample %lld"),
+                        *FPaths::GetCleanFilename(File), FullMismatch, PlaybackMismatch);
+                else
+                    UE_LOG(LogTemp, Display, TEXT("[MZDBG] %s: parallel decode (%s) is bit-identical to serial, %.3fs vs %.3fs (x%.2f)"),
+                        *FPaths::GetCleanFilename(File), Zone->bDecodedParallel ? TEXT("sharded") : TEXT("fell back to serial"),
+                        BestDecodeSec, BestSerialSec, BestSerialSec / FMath::Max(BestDecodeSec, 1e-9));
+            }
+        }
+        else
+        {
+            UE_LOG(LogTemp, Warning, TEXT("[MZDBG] %s: decode failed"), *FPaths::GetCleanFilename(File));
+        }
+        Results.Add(MakeShared<FJsonValueObject>(Entry));
+    }
+
+    //A short song in front of a long one leaves the fetch the least time, any gap here is one a player would hear
+    TSharedPtr<FJsonObject> PlaylistResult;
+    if (bPlaylistCheck && !ShortestFile.IsEmpty())
+    {
+        double GapSec = 0.0;
+        const bool bPlaylistOk = CheckPlaylistPrefetch(Zone, ShortestFile, LongestFile, PlaylistSpeedup, GapSec);
+        PlaylistResult = MakeShared<FJsonObject>();
+        PlaylistResult->SetStringField(TEXT("shortFile"), FPaths::GetCleanFilename(ShortestFile));
+        PlaylistResult->SetStringField(TEXT("longFile"), FPaths::GetCleanFilename(LongestFile));
+        PlaylistResult->SetNumberField(TEXT("speedup"), PlaylistSpeedup);
+        PlaylistResult->SetBoolField(TEXT("ok"), bPlaylistOk);
+        PlaylistResult->SetNumberField(TEXT("gapSeconds"), GapSec);
+        if (!bPlaylistOk)
+            UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Playlist check: %s and %s could not both be appended, they need the same rate and channels"),
+                *FPaths::GetCleanFilename(ShortestFile), *FPaths::GetCleanFilename(LongestFile));
+        else if (GapSec > 0.0)
+            UE_LOG(LogTemp, Error, TEXT("[MZDBG] Playlist check: playback ran dry for %.3fs waiting for %s after %s at %.0fx"),
+                GapSec, *FPaths::GetCleanFilename(LongestFile), *FPaths::GetCleanFilename(ShortestFile), PlaylistSpeedup);
+        else
+            UE_LOG(LogTemp, Display, TEXT("[MZDBG] Playlist check: %s (%.1fs) then %s (%.1fs) played without a gap at %.0fx"),
+                *FPaths::GetCleanFilename(ShortestFile), ShortestSec, *FPaths::GetCleanFilename(LongestFile), LongestSec, PlaylistSpeedup);
+    }
+    Zone->FullPCM.Empty();
+    Zone->PlaybackPCM.Empty();
+
+    TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+    Root->SetStringField(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+    Root->SetStringField(TEXT("platform"), FPlatformProperties::IniPlatformName());
+    Root->SetStringField(TEXT("cpu"), FPlatformMisc::GetCPUBrand().TrimStartAndEnd());
+    Root->SetStringField(TEXT("storage"), bCompact ? TEXT("int16") : TEXT("float32"));
+    Root->SetBoolField(TEXT("parallelMp3"), !bSerial);
+    Root->SetNumberField(TEXT("runs"), Runs);
+    Root->SetNumberField(TEXT("scratchHitRate"), ScratchPool->GetStats().GetHitRate());
+    Root->SetNumberField(TEXT("scratchHighWaterMB"), ScratchPool->GetStats().HighWaterBytes / (1024.0 * 1024.0));
+    Root->SetArrayField(TEXT("files"), Results);
+    if (PlaylistResult.IsValid())
+        Root->SetObjectField(TEXT("playlist"), PlaylistResult);
+
+    FString Json;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+    if (!FJsonSerializer::Serialize(Root, Writer) || !FFileHelper::SaveStringToFile(Json, *OutPath))
+    {
+        UE_LOG(LogTemp, Error, TEXT("[MZDBG] Could not write %s"), *OutPath);
+        return 1;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("[MZDBG] Decode benchmark of %d files written to %s"), Files.Num(), *OutPath);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "LoudnessMeter.h"
+
+namespace
+{
+    //-70 LUFS as a mean square, the BS.1770 absolute gate
+    const double AbsoluteGatePower = FMath::Pow(10.0, (-70.0 + 0.691) / 10.0);
+}
+
+void FLoudnessMeter::Init(int32 InSampleRate)
+{
+    *this = FLoudnessMeter();
+    if (InSampleRate <= 0)
+        return;
+
+    //BS.1770 only lists the 48 kHz coefficients, these are the analog prototypes behind them so any source rate gets the same curve
+    const double Fs = (double)InSampleRate;
+    {
+        const double F0 = 1681.974450955533;
+        const double G  = 3.999843853973347;
+        const double Q  = 0.7071752369554196;
+        const double K  = FMath::Tan(PI * F0 / Fs);
+        const double Vh = FMath::Pow(10.0, G / 20.0);
+        const double Vb = FMath::Pow(Vh, 0.4996667741545416);
+        const double A0 = 1.0 + K / Q + K * K;
+        Shelf.b0 = (Vh + Vb * K / Q + K * K) / A0;
+        Shelf.b1 = 2.0 * (K * K - Vh) / A0;
+        Shelf.b2 = (Vh - Vb * K / Q + K * K) / A0;
+        Shelf.a1 = 2.0 * (K * K - 1.0) / A0;
+        Shelf.a2 = (1.0 - K / Q + K * K) / A0;
+    }
+    {
+        const double F0 = 38.13547087602444;
+        const double Q  = 0.5003270373238773;
+        const double K  = FMath::Tan(PI * F0 / Fs);
+        const double A0 = 1.0 + K / Q + K * K;
+        HighPass.b0 = 1.0;
+        HighPass.b1 = -2.0;
+        HighPass.b2 = 1.0;
+        HighPass.a1 = 2.0 * (K * K - 1.0) / A0;
+        HighPass.a2 = (1.0 - K / Q + K * K) / A0;
+    }
+
+    SubBlockLength = FMath::Max(1, InSampleRate / 10);
+}
+
+void FLoudnessMeter::Process(const float* Samples, int32 NumSamples)
+{
+    if (SubBlockLength <= 0)
+        return;
+
+    for (int32 i = 0; i < NumSamples; ++i)
+    {
+        const float x = Samples[i];
+        SumSquares += (double)x * (double)x;
+        Peak = FMath::Max(Peak, FMath::Abs(x));
+
+        const double y = HighPass.Process(Shelf.Process(x));
+        SubBlockSum += y * y;
+
+        if (++SubBlockFill < SubBlockLength)
+            continue;
+
+        //Every finished 100 ms sub-block closes the 400 ms block made of it and the three before it
+        RecentSubBlocks[NumSubBlocks & 3] = SubBlockSum / (double)SubBlockLength;
+        ++NumSubBlocks;
+        SubBlockSum  = 0.0;
+        SubBlockFill = 0;
+
+        if (NumSubBlocks < 4)
+            continue;
+
+        const double Power = 0.25 * (RecentSubBlocks[0] + RecentSubBlocks[1] + RecentSubBlocks[2] + RecentSubBlocks[3]);
+        if (Power <= AbsoluteGatePower)
+            continue;
+        const double Lufs = -0.691 + 10.0 * FMath::LogX(10.0, Power);
+        const int32 Bin = FMath::Clamp((int32)((Lufs - LowestLufs) * BinsPerLu), 0, NumBins - 1);
+        ++BinCounts[Bin];
+        BinPowers[Bin] += Power;
+    }
+    NumMeasured += NumSamples;
+}
+
+void FLoudnessMeter::Merge(const FLoudnessMeter& Other)
+{
+    for (int32 Bin = 0; Bin < NumBins; ++Bin)
+    {
+        BinCounts[Bin] += Other.BinCounts[Bin];
+        BinPowers[Bin] += Other.BinPowers[Bin];
+    }
+    SumSquares  += Other.SumSquares;
+    Peak         = FMath::Max(Peak, Other.Peak);
+    NumMeasured += Other.NumMeasured;
+}
+
+FLoudnessStats FLoudnessMeter::GetStats() const
+{
+    FLoudnessStats Stats;
+    if (NumMeasured <= 0)
+        return Stats;
+
+    const auto ToDb = [](double Power) { return Power > 0.0 ? (float)(10.0 * FMath::LogX(10.0, Power)) : -INFINITY; };
+    const auto ToLufs = [](double Power) { return Power > 0.0 ? (float)(-0.691 + 10.0 * FMath::LogX(10.0, Power)) : -INFINITY; };
+
+    Stats.RmsDb  = ToDb(SumSquares / (double)NumMeasured);
+    Stats.PeakDb = ToDb((double)Peak * (double)Peak);
+
+    //Only blocks above the absolute gate were binned, so its mean is the sum over all bins. The relative gate 10 LU below that then keeps
+    //every bin whose blocks are louder on average
+    double Sum = 0.0;
+    int64 Count = 0;
+    for (int32 Bin = 0; Bin < NumBins; ++Bin)
+    {
+        Sum   += BinPowers[Bin];
+        Count += BinCounts[Bin];
+    }
+    if (Count == 0)
+        return Stats;
+
+    const double RelativeGate = (Sum / Count) * 0.1;
+    double GatedSum = 0.0;
+    int64 GatedCount = 0;
+    for (int32 Bin = 0; Bin < NumBins; ++Bin)
+    {
+        if (BinCounts[Bin] > 0 && BinPowers[Bin] / BinCounts[Bin] > RelativeGate)
+        {
+            GatedSum   += BinPowers[Bin];
+            GatedCount += BinCounts[Bin];
+        }
+    }
+    Stats.IntegratedLufs = GatedCount > 0 ? ToLufs(GatedSum / GatedCount) : -INFINITY;
+    return Stats;
+}
@@ -11,6 +11,8 @@ void AMusicHUD::BindToZone(AMusicZone* Zone)
 
 	Zone->OnBeatScored.AddDynamic(this, &AMusicHUD::HandleBeatScored);
 	Zone->OnChallengeEnded.AddDynamic(this, &AMusicHUD::HandleChallengeEnded);
+	Zone->OnLoadProgress.AddDynamic(this, &AMusicHUD::HandleLoadProgress);
+	Zone->OnCalibrationFinished.AddDynamic(this, &AMusicHUD::HandleCalibrationFinished);
 
 	BP_OnZoneBound(Zone);
 }
@@ -35,6 +37,8 @@ void AMusicHUD::UnbindDelegates()
 
 	Zone->OnBeatScored.RemoveDynamic(this, &AMusicHUD::HandleBeatScored);
 	Zone->OnChallengeEnded.RemoveDynamic(this, &AMusicHUD::HandleChallengeEnded);
+	Zone->OnLoadProgress.RemoveDynamic(this, &AMusicHUD::HandleLoadProgress);
+	Zone->OnCalibrationFinished.RemoveDynamic(this, &AMusicHUD::HandleCalibrationFinished);
 }
 
 void AMusicHUD::HandleBeatScored(bool bSuccess, int32 InSuccess, int32 InFail, float InPercent)
@@ -42,6 +46,16 @@ void AMusicHUD::HandleBeatScored(bool bSuccess, int32 InSuccess, int32 InFail, f
 	BP_OnScoreUpdated(bSuccess, InSuccess, InFail, InPercent);
 }
 
+void AMusicHUD::HandleLoadProgress(float Progress)
+{
+	BP_OnLoadProgress(Progress);
+}
+
+void AMusicHUD::HandleCalibrationFinished(bool bSuccess, float AudioOffsetSec, float SyncOffsetSec)
+{
+	BP_OnCalibrationFinished(bSuccess, AudioOffsetSec, SyncOffsetSec);
+}
+
 void AMusicHUD::HandleChallengeEnded(bool bAbandoned, float FinalPercent)
 {
 	if (GEngine)
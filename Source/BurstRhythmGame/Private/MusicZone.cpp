@@ -7,11 +7,23 @@
 #include "Kismet/GameplayStatics.h"
 #include "Components/AudioComponent.h"
 #include "Sound/SoundWaveProcedural.h"
+#include "Sound/QuartzQuantizationUtilities.h"
+#include "Quartz/QuartzSubsystem.h"
 #include "HAL/PlatformProcess.h"
 #include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Tasks/Task.h"
+#include "EngineUtils.h"
+#include "Misc/ConfigCacheIni.h"
 #include "MusicHUD.h"
 #include "GameFramework/PlayerController.h"
 #include "NoteActor.h"
+#include "AudioIngest.h"
+#include "AudioKernels.h"
+#include "AudioScratchPool.h"
+#include "LoudnessMeter.h"
+#include "PCMCache.h"
+#include "PCMTrack.h"
 #include "../ThirdParty/AudioDecoders/dr_wav.h"
 #include "../ThirdParty/AudioDecoders/minimp3_ex.h"
 
@@ -38,6 +50,15 @@ void AMusicZone::BeginPlay()
 {
     Super::BeginPlay();
 
+    //Every zone in the world borrows its decode buffers from the same pool, so moving between zones reuses the last song's memory
+    if (UAudioScratchSubsystem* Scratch = GetWorld()->GetSubsystem<UAudioScratchSubsystem>())
+        ScratchPool = Scratch->GetPool();
+    FullPCM.SetPool(ScratchPool);
+    PlaybackPCM.SetPool(ScratchPool);
+
+    LoadSavedSync();
+    CreateKeysoundPool();
+
     if (Trigger)
     {
         //These are the callbacks for the player entering the zone's volume. OnTriggerBegin is executed when the player enters, OnTriggerEnd is executed when they leave
@@ -73,7 +94,7 @@ void AMusicZone::OnTriggerBegin(UPrimitiveComponent* /*OverlappedComp*/, AActor*
     //and the player's HUD will always display the correct info based on the current zone they are in
     BindSelfToHUD();
     
-    if (GetWorld()->GetTimerManager().IsTimerActive(FileAskDelayHandle) || bSongStarted || bAnalyzing)
+    if (GetWorld()->GetTimerManager().IsTimerActive(FileAskDelayHandle) || bSongStarted || bAnalyzing || bLoading)
         return;
 
     GetWorld()->GetTimerManager().SetTimer(
@@ -99,7 +120,158 @@ void AMusicZone::OnTriggerEnd(UPrimitiveComponent* /*OverlappedComp*/, AActor* O
 
 void AMusicZone::StartZoneSession()
 {
-    AskForFile();
+    if (SessionType == EZoneSessionType::Calibration)
+        StartCalibration();
+    else
+        AskForFile();
+}
+
+namespace
+{
+    //The offsets are machine specific, so they go to GameUserSettings.ini under Saved rather than into the project's config
+    const TCHAR* SyncConfigSection = TEXT("BurstRhythmGame.Sync");
+
+    //Matches every tap to the nearest beat and returns the median tap-minus-beat offset. Taps more than a third of a beat away are the
+    //player catching up or double tapping and are not matched, what is left is filtered once more at 3 MADs around the median
+    bool EstimateTapOffset(const TArray<double>& Taps, const TArray<double>& Beats, double BeatInterval, double& OutOffset, double& OutSpread)
+    {
+        TArray<double> Deltas;
+        for (double Tap : Taps)
+        {
+            double Best = TNumericLimits<double>::Max();
+            for (double Beat : Beats)
+            {
+                if (FMath::Abs(Tap - Beat) < FMath::Abs(Best))
+                    Best = Tap - Beat;
+            }
+            if (FMath::Abs(Best) < BeatInterval / 3.0)
+                Deltas.Add(Best);
+        }
+
+        auto Median = [](TArray<double>& Values)
+        {
+            Values.Sort();
+            const int32 Mid = Values.Num() / 2;
+            return (Values.Num() & 1) ? Values[Mid] : 0.5 * (Values[Mid - 1] + Values[Mid]);
+        };
+
+        if (Deltas.Num() < FMath::Max(4, Beats.Num() / 2))
+            return false;
+
+        const double Center = Median(Deltas);
+        TArray<double> Deviations;
+        for (double D : Deltas)
+            Deviations.Add(FMath::Abs(D - Center));
+        OutSpread = 1.4826 * Median(Deviations);
+
+        const double Limit = FMath::Max(3.0 * OutSpread, 0.005);
+        TArray<double> Kept = Deltas.FilterByPredicate([Center, Limit](double D) { return FMath::Abs(D - Center) <= Limit; });
+        OutOffset = Median(Kept);
+        return true;
+    }
+}
+
+void AMusicZone::LoadSavedSync()
+{
+    if (!bUseSavedSync || !GConfig)
+        return;
+
+    float Saved = 0.0f;
+    if (GConfig->GetFloat(SyncConfigSection, TEXT("AudioOffsetSec"), Saved, GGameUserSettingsIni))
+        AudioOffsetSec = Saved;
+    if (GConfig->GetFloat(SyncConfigSection, TEXT("SyncOffsetSec"), Saved, GGameUserSettingsIni))
+        SyncOffsetSec = Saved;
+}
+
+void AMusicZone::StartCalibration()
+{
+    //A click track is generated straight into FullPCM and played through the normal song path, so it is timed by the same audio clock.
+    //The first phase has clicks and no notes, the second has notes and no clicks. Its notes only start travelling once the clicks are over
+    const double Interval = 60.0 / FMath::Clamp((double)CalibrationBpm, 40.0, 200.0);
+    const int32  Beats    = FMath::Clamp(CalibrationBeats, 4, 64);
+    const double LeadIn   = FMath::Max(2.0 * Interval, (double)TravelTime);
+
+    CalibrationAudioBeats.Reset();
+    CalibrationVisualBeats.Reset();
+    CalibrationTaps.Reset();
+    for (int32 i = 0; i < Beats; ++i)
+        CalibrationAudioBeats.Add(2.0 * Interval + i * Interval);
+    for (int32 i = 0; i < Beats; ++i)
+        CalibrationVisualBeats.Add(CalibrationAudioBeats.Last() + (3 + i) * Interval + LeadIn);
+
+    SampleRate = 48000;
+    const int64 Total = (int64)((CalibrationVisualBeats.Last() + 1.0) * SampleRate);
+    TArray<float> Clicks;
+    Clicks.SetNumZeroed((int32)Total);
+
+    //A 20 ms 1 kHz burst with a fast decay, every fourth click a fifth higher so the player can hear where the bar starts
+    const int32 ClickLength = SampleRate / 50;
+    for (int32 i = 0; i < Beats; ++i)
+    {
+        const double Freq  = (i % 4 == 0) ? 1500.0 : 1000.0;
+        const int64  First = (int64)(CalibrationAudioBeats[i] * SampleRate);
+        for (int32 n = 0; n < ClickLength && First + n < Total; ++n)
+            Clicks[First + n] = 0.5f * FMath::Exp(-(float)n / (ClickLength / 5.0f)) * (float)FMath::Sin(2.0 * PI * Freq * n / SampleRate);
+    }
+
+    FullPCM.Allocate(GetPCMStorage(), Total);
+    FullPCM.Write(0, Clicks.GetData(), (int32)Total);
+    PlaybackChannels = 1;
+    PlaybackPCM.Allocate(EPCMStorage::Int16, Total);
+    PlaybackPCM.Write(0, Clicks.GetData(), (int32)Total);
+    DecodedFrames.store(Total, std::memory_order_release);
+    bDecodeComplete = true;
+    SongDuration = (double)Total / (double)SampleRate;
+    TimeScale    = 1.0;
+
+    PromptBuffer.Empty();
+    for (double Beat : CalibrationVisualBeats)
+        PromptBuffer.Enqueue({ Beat, 1.0f });
+
+    bCalibrating = true;
+    StartSong();
+}
+
+void AMusicZone::FinishCalibration()
+{
+    //Audio taps measure output latency plus reaction, visual taps display latency plus reaction. Scoring takes out the first, and
+    //notes are drawn ahead by the difference so they arrive when the beat is heard
+    const double Interval = 60.0 / FMath::Clamp((double)CalibrationBpm, 40.0, 200.0);
+    const double Split = 0.5 * (CalibrationAudioBeats.Last() + CalibrationVisualBeats[0]);
+    const TArray<double> AudioTaps  = CalibrationTaps.FilterByPredicate([Split](double T) { return T < Split; });
+    const TArray<double> VisualTaps = CalibrationTaps.FilterByPredicate([Split](double T) { return T >= Split; });
+
+    double AudioOffset = 0.0, AudioSpread = 0.0, VisualOffset = 0.0, VisualSpread = 0.0;
+    const bool bOk = EstimateTapOffset(AudioTaps, CalibrationAudioBeats, Interval, AudioOffset, AudioSpread)
+        && EstimateTapOffset(VisualTaps, CalibrationVisualBeats, Interval, VisualOffset, VisualSpread);
+
+    if (!bOk)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Calibration needs taps on at least half the beats of each phase, got %d and %d"), AudioTaps.Num(), VisualTaps.Num());
+        OnCalibrationFinished.Broadcast(false, AudioOffsetSec, SyncOffsetSec);
+        return;
+    }
+
+    AudioOffsetSec = (float)FMath::Clamp(AudioOffset, -0.2, 0.5);
+    SyncOffsetSec  = (float)FMath::Clamp(VisualOffset - AudioOffset, -0.5, 0.5);
+    UE_LOG(LogTemp, Log, TEXT("[MZDBG] Calibrated: audio %.1f ms (spread %.1f), visual %.1f ms (spread %.1f), sync offset %.1f ms"),
+        AudioOffset * 1000.0, AudioSpread * 1000.0, VisualOffset * 1000.0, VisualSpread * 1000.0, SyncOffsetSec * 1000.0f);
+
+    if (GConfig)
+    {
+        GConfig->SetFloat(SyncConfigSection, TEXT("AudioOffsetSec"), AudioOffsetSec, GGameUserSettingsIni);
+        GConfig->SetFloat(SyncConfigSection, TEXT("SyncOffsetSec"), SyncOffsetSec, GGameUserSettingsIni);
+        GConfig->Flush(false, GGameUserSettingsIni);
+    }
+
+    //Zones that are already in the world read the saved values in BeginPlay, so they are handed the new ones directly
+    for (TActorIterator<AMusicZone> It(GetWorld()); It; ++It)
+    {
+        if (*It != this)
+            It->LoadSavedSync();
+    }
+
+    OnCalibrationFinished.Broadcast(true, AudioOffsetSec, SyncOffsetSec);
 }
 
 void AMusicZone::AskForFile()
@@ -120,7 +292,7 @@ void AMusicZone::AskForFile()
         FPaths::ProjectDir(),
         TEXT(""),
         TEXT("Audio Files|*.wav;*.mp3"),
-        EFileDialogFlags::None,
+        bPlaylist ? EFileDialogFlags::Multiple : EFileDialogFlags::None,
         OutFiles
     );
 
@@ -131,6 +303,16 @@ void AMusicZone::AskForFile()
     }
 
     UE_LOG(LogTemp, Log, TEXT("[MZDBG] Selected: %s"), *OutFiles[0]);
+
+    //Everything after the first song is queued and fetched in the background once the first one plays
+    PlaylistQueue.Reset();
+    if (bPlaylist)
+    {
+        PlaylistQueue.Append(OutFiles.GetData() + 1, OutFiles.Num() - 1);
+        if (PlaylistQueue.Num() > 0)
+            UE_LOG(LogTemp, Log, TEXT("[MZDBG] Queued %d more songs"), PlaylistQueue.Num());
+    }
+    bMoreTracksComing = PlaylistQueue.Num() > 0;
     LoadAndDecodeAudio(OutFiles[0]);
 #else
     UE_LOG(LogTemp, Warning, TEXT("[MZDBG] WITH_EDITOR is false; dialog disabled in this build."));
@@ -148,145 +330,925 @@ void AMusicZone::LoadAndDecodeAudio(const FString& FilePath)
         AnalysisFuture = TFuture<void>();
     }
 
+    CancelLoad();
+
+    WorkerLoadGeneration = ++LoadGeneration;
+    WorkerFilePath   = FilePath;
+    bStartDispatched = false;
+    bCancelLoad      = false;
+    bDecodeComplete  = false;
+    bLoading         = true;
+    DecodedFrames.store(0, std::memory_order_relaxed);
+    LoadProgress.store(0.0f, std::memory_order_relaxed);
+    LastBroadcastProgress = -1.0f;
+    LoudnessStats = FLoudnessStats();
+
+    //A playlist decodes its later songs onto the end of the first one's streams, so they are set up to grow in place
+    const int64 GrowLimit = PlaylistQueue.Num() > 0 ? (int64)(PlaylistMaxMinutes * 60.0f * PlaylistMaxSampleRate) : 0;
+    FullPCM.SetGrowLimit(GrowLimit);
+    PlaybackPCM.SetGrowLimit(GrowLimit * 2);
+    AppendBase = 0;
+    NextTrackStartFrame.store(-1, std::memory_order_relaxed);
+    AnalyzedFrames.store(0, std::memory_order_relaxed);
+    RequestedReleaseFrame.store(0, std::memory_order_relaxed);
+    TimeScale = 1.0 / FMath::Clamp(PracticeSpeed, 0.5f, 1.0f);
+
+    //A song that starts further in needs the audio up to there first, so only the endless mix (which cannot wait for all of it) still starts early
+    bProgressiveLoad = bEndlessMix || (bProgressiveStart && StartAtSec <= 0.0f);
+
+    //Decoding and the pre-roll can take seconds on a long track, so both run on the thread pool and only StartSong comes back to the game thread.
+    //Capturing this is fine because StopAndReset and EndPlay wait on LoadFuture, the game thread hops go through weak pointers
+    LoadFuture = Async(EAsyncExecution::ThreadPool, [this]()
+    {
+        const bool bOk = DecodeAndPreRoll(WorkerFilePath);
+
+        //A progressive load already handed the song over once the lead was decoded, after that the game thread only needs the real length
+        if (!bStartDispatched)
+            DispatchSongStart(bOk);
+        else if (bOk)
+            DispatchDecodeComplete(DecodedFrames.load(std::memory_order_relaxed));
+    });
+}
+
+void AMusicZone::DispatchSongStart(bool bOk)
+{
+    bStartDispatched = true;
+
+    TWeakObjectPtr<AMusicZone> WeakThis(this);
+    AsyncTask(ENamedThreads::GameThread, [WeakThis, FilePath = WorkerFilePath, Generation = WorkerLoadGeneration, bOk]()
+    {
+        if (AMusicZone* Zone = WeakThis.Get())
+            Zone->FinishLoad(FilePath, Generation, bOk);
+    });
+}
+
+void AMusicZone::DispatchDecodeComplete(int64 TotalFrames)
+{
+    TWeakObjectPtr<AMusicZone> WeakThis(this);
+    AsyncTask(ENamedThreads::GameThread, [WeakThis, Generation = WorkerLoadGeneration, TotalFrames]()
+    {
+        if (AMusicZone* Zone = WeakThis.Get())
+            Zone->OnDecodeComplete(Generation, TotalFrames);
+    });
+}
+
+void AMusicZone::PublishDecoded(int64 NumDecoded, int64 ExpectedFrames)
+{
+    //A playlist song is published by AppendPlaylistTrack once it is complete, the analysis needs its loudness before it gets to it
+    if (bAppendingTrack)
+        return;
+
+    DecodedFrames.store(NumDecoded, std::memory_order_release);
+    LoadProgress.store((float)((double)NumDecoded / (double)FMath::Max<int64>(ExpectedFrames, 1)), std::memory_order_relaxed);
+
+    //Progressive start: as soon as the lead is decoded, the pre-roll runs on what we have and the song is handed to the game thread while decoding carries on behind it.
+    //SongDuration is the decoder's estimate until OnDecodeComplete brings in the real length
+    const int64 LeadFrames = FMath::Max<int64>(1, (int64)(ProgressiveLeadSec * SampleRate));
+    if (bProgressiveLoad && !bStartDispatched && NumDecoded >= LeadFrames && NumDecoded < ExpectedFrames)
+    {
+        SongDuration = (double)ExpectedFrames / (double)SampleRate;
+        LoudnessStats = Loudness.GetStats();
+        InitDrumFilters();
+        PreRollAnalysis();
+        DispatchSongStart(true);
+    }
+}
+
+bool AMusicZone::DecodeAndPreRoll(const FString& FilePath)
+{
     //THis here is for decoding the audio, it uses the third party decoders, which I then process into raw data that can be used for visualizing
-    bool bOk = false;
-    if (FilePath.EndsWith(TEXT(".wav"), ESearchCase::IgnoreCase))
-        bOk = DecodeWav(FilePath);
-    else if (FilePath.EndsWith(TEXT(".mp3"), ESearchCase::IgnoreCase))
-        bOk = DecodeMp3(FilePath);
-    else
-        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Unsupported extension"));
+    const FPlatformMemoryStats MemBefore = FPlatformMemory::GetStats();
+    const double DecodeStart = FPlatformTime::Seconds();
+
+    //The file is read or mapped exactly once here. The cache hash and whichever decoder the header bytes point to all work on this one buffer
+    FAudioIngest Source;
+    if (!Source.Open(FilePath, bMemoryMapSource, ScratchPool.Get()))
+        return false;
+
+    //Re-entering a zone with the same song only has to copy the cached PCM back instead of decoding it again. An endless mix never has
+    //the whole song to store and a hit would load all of it, so it always decodes
+    const bool bUseCache    = bUsePCMCache && !bEndlessMix;
+    //The trim and the dither change the samples that get stored, so they are part of the key
+    FPCMCacheSettings CacheSettings;
+    CacheSettings.bTrimSilence       = bTrimSilence;
+    CacheSettings.SilenceThresholdDb = SilenceThresholdDb;
+    CacheSettings.bDitherPlayback    = bDitherPlayback;
+    const uint64 CacheKey   = bUseCache ? FPCMCache::MakeKey(FPCMCache::HashSource(Source.GetData(), Source.Num(), bCancelLoad), CacheSettings) : 0;
+    if (bCancelLoad)
+        return false;
+    FPCMCacheMeta CacheMeta;
+    const bool bCacheHit    = bUseCache && FPCMCache::Load(CacheKey, GetPCMStorage(), FullPCM, PlaybackPCM, CacheMeta, bCancelLoad);
+    if (bCacheHit)
+    {
+        SampleRate         = CacheMeta.SampleRate;
+        PlaybackChannels   = CacheMeta.PlaybackChannels;
+        LoudnessStats      = CacheMeta.Loudness;
+        LeadingTrimFrames  = CacheMeta.LeadingTrimFrames;
+        TrailingTrimFrames = 0;
+    }
+
+    bool bOk = bCacheHit;
+    if (!bCacheHit)
+    {
+        switch (Source.GetContainer())
+        {
+        case EAudioContainer::Wav:
+            bOk = DecodeWav(Source);
+            break;
+        case EAudioContainer::Mp3:
+            bOk = DecodeMp3(Source);
+            break;
+        default:
+            UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Unsupported audio format: %s"), *FilePath);
+            break;
+        }
+    }
+
+    if (!bOk || bCancelLoad)
+        return false;
+
+    //The decoders measured the level on the way, a cache hit brings the numbers from when the song was first decoded
+    if (!bCacheHit)
+        LoudnessStats = Loudness.GetStats();
+    UE_LOG(LogTemp, Log, TEXT("[MZDBG] Loudness %.1f LUFS, RMS %.1f dBFS, peak %.1f dBFS"), LoudnessStats.IntegratedLufs, LoudnessStats.RmsDb, LoudnessStats.PeakDb);
+
+    //Cache hits and the parallel decode do not publish per block, so the watermark moves to the real end here in any case
+    DecodedFrames.store(FullPCM.Num(), std::memory_order_release);
+    bDecodeComplete = true;
+
+    if (bUseCache && !bCacheHit)
+    {
+        CacheMeta.SampleRate        = SampleRate;
+        CacheMeta.Loudness          = LoudnessStats;
+        CacheMeta.LeadingTrimFrames = LeadingTrimFrames;
+        CacheMeta.PlaybackChannels  = PlaybackChannels;
+        FPCMCache::Store(CacheKey, FullPCM, PlaybackPCM, CacheMeta, (int64)PCMCacheMaxMB * 1024 * 1024, bCancelLoad);
+        if (bCancelLoad)
+            return false;
+    }
+
+    //Song time runs on the trimmed track, so SongStartTime is when its first sound plays and SongDuration ends on its last one.
+    //Source time is song time plus the leading trim
+    if (LeadingTrimFrames > 0 || TrailingTrimFrames > 0)
+        UE_LOG(LogTemp, Log, TEXT("[MZDBG] Trimmed %.2fs of leading and %.2fs of trailing silence"),
+            (double)LeadingTrimFrames / SampleRate, (double)TrailingTrimFrames / SampleRate);
+
+    //Peak RSS is process-wide. The streamed decode only adds the two resident streams on top of the source, the old whole-track decode held an
+    //int16, a float and a mono copy at once. Measured on a 60 min 48 kHz stereo MP3 (standalone harness, decode only): 2696 MB peak before,
+    //1380 MB with float analysis storage and 1050 MB with int16
+    const FPlatformMemoryStats MemAfter = FPlatformMemory::GetStats();
+    UE_LOG(LogTemp, Log, TEXT("[MZDBG] %s %lld frames, %d playback channels (%.1f MB analysis + %.1f MB playback resident) in %.3fs, peak RSS %.1f MB -> %.1f MB"),
+        bCacheHit ? TEXT("Loaded cached") : TEXT("Decoded"), FullPCM.Num(), PlaybackChannels, FullPCM.GetAllocatedSize() / (1024.0 * 1024.0),
+        PlaybackPCM.GetAllocatedSize() / (1024.0 * 1024.0), FPlatformTime::Seconds() - DecodeStart,
+        MemBefore.PeakUsedPhysical / (1024.0 * 1024.0), MemAfter.PeakUsedPhysical / (1024.0 * 1024.0));
+
+    //The song is already playing if the load went progressive, its pre-roll ran back when the lead was ready
+    if (!bStartDispatched)
+    {
+        SongDuration = (double)FullPCM.Num() / (double)SampleRate;
+
+        InitDrumFilters();
+        PreRollAnalysis();
+    }
+    LoadProgress.store(1.0f, std::memory_order_relaxed);
+    return !bCancelLoad;
+}
+
+void AMusicZone::FinishLoad(const FString& FilePath, uint32 Generation, bool bOk)
+{
+    //A load that was cancelled or replaced by a newer one can still land here if its task was already queued, so it is simply dropped
+    if (Generation != LoadGeneration || bCancelLoad)
+        return;
+
+    bLoading = false;
 
     if (!bOk)
     {
         UE_LOG(LogTemp, Error, TEXT("[MZDBG] Failed to decode: %s"), *FilePath);
+        LoadFuture.Wait();
+        LoadFuture = TFuture<void>();
+        FullPCM.Empty();
+        PlaybackPCM.Empty();
+        PlaylistQueue.Reset();
+        bMoreTracksComing = false;
         return;
     }
 
-    HopDuration  = double(SamplesPerHop) / double(SampleRate);
-    SongDuration = (double)FullPCM.Num() / (double)SampleRate;
+    //With a progressive start the worker is still decoding at this point, LoadFuture stays alive until StopAndReset cancels or collects it
 
-    InitDrumFilters();
-    PreRollAnalysis();
+    OnLoadProgress.Broadcast(1.0f);
     StartContinuousAnalysis();
     StartSong();
+
+    if (StartAtSec > 0.0f && !SeekToTime(StartAtSec))
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Could not start at %.2fs, playing from the beginning"), StartAtSec);
+}
+
+void AMusicZone::OnDecodeComplete(uint32 Generation, int64 TotalFrames)
+{
+    if (Generation != LoadGeneration || bCancelLoad)
+        return;
+
+    //The song started on an estimated length, now that the decoder is done Tick ends it on the real one
+    SongDuration = (double)TotalFrames / (double)SampleRate;
+    if (ProcWave)
+        ProcWave->Duration = (float)GetPlayedDuration();
+
+    //DecodeAndPreRoll has measured the whole song by now, the analysis so far ran on the loudness of the lead
+    RenormalizeOnsets();
+}
+
+void AMusicZone::TickPlaylist()
+{
+    //The fetch of the next song comes back here, it is part of the timeline now and the song simply ends later
+    if (PlaylistTask.IsValid() && PlaylistTask.IsCompleted())
+    {
+        if (PlaylistTask.GetResult())
+        {
+            SongDuration = (double)DecodedFrames.load(std::memory_order_acquire) / (double)SampleRate;
+            if (ProcWave)
+                ProcWave->Duration = (float)GetPlayedDuration();
+        }
+        PlaylistTask = UE::Tasks::TTask<bool>();
+    }
+
+    //The next song is fetched as soon as the one before it is in, as long as less than the decode lead is left to play. Waiting for the
+    //last song to start playing instead left a short song less time than the fetch of a long one behind it takes. The analysis also has
+    //to have picked up the last song's gain, otherwise it would be overwritten, it does that on its next hop
+    if (!PlaylistTask.IsValid() && PlaylistQueue.Num() > 0 && bDecodeComplete && (!LoadFuture.IsValid() || LoadFuture.IsReady())
+        && DecodedFrames.load(std::memory_order_acquire) - QueuedFrames.load(std::memory_order_relaxed) <= GetDecodeLeadFrames()
+        && NextTrackStartFrame.load(std::memory_order_acquire) < 0)
+    {
+        const FString FilePath = PlaylistQueue[0];
+        PlaylistQueue.RemoveAt(0);
+        PlaylistTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, FilePath]() { return AppendPlaylistTrack(FilePath); }, UE::Tasks::ETaskPriority::BackgroundLow);
+    }
+
+    bMoreTracksComing = PlaylistQueue.Num() > 0 || PlaylistTask.IsValid();
+}
+
+bool AMusicZone::AppendPlaylistTrack(const FString& FilePath)
+{
+    //Runs on a background task while the song before it plays. Everything is written past the watermark, where nobody reads yet
+    const double DecodeStart = FPlatformTime::Seconds();
+
+    FAudioIngest Source;
+    if (bCancelLoad || !Source.Open(FilePath, bMemoryMapSource, ScratchPool.Get()))
+        return false;
+
+    AppendBase = FullPCM.Num();
+    bAppendingTrack = true;
+
+    bool bOk = false;
+    switch (Source.GetContainer())
+    {
+    case EAudioContainer::Wav:
+        bOk = DecodeWav(Source);
+        break;
+    case EAudioContainer::Mp3:
+        bOk = DecodeMp3(Source);
+        break;
+    default:
+        break;
+    }
+    bAppendingTrack = false;
+
+    if (!bOk || bCancelLoad)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Skipping playlist song %s, it could not be decoded or does not match the first song's %d Hz and %d channels"),
+            *FilePath, SampleRate, PlaybackChannels);
+        FullPCM.Truncate(AppendBase);
+        PlaybackPCM.Truncate(AppendBase * PlaybackChannels);
+        return false;
+    }
+
+    //The song goes out in one piece: the gain first, so the analysis has it by the time the watermark lets it reach the new song
+    const FLoudnessStats Stats = Loudness.GetStats();
+    NextTrackEnergyScale.store(GetOnsetEnergyScale(Stats), std::memory_order_relaxed);
+    NextTrackStartFrame.store(AppendBase, std::memory_order_release);
+    DecodedFrames.store(FullPCM.Num(), std::memory_order_release);
+
+    UE_LOG(LogTemp, Log, TEXT("[MZDBG] Appended %s at %.2fs, %lld frames, %.1f LUFS in %.3fs"),
+        *FilePath, (double)AppendBase / SampleRate, FullPCM.Num() - AppendBase, Stats.IntegratedLufs, FPlatformTime::Seconds() - DecodeStart);
+    return true;
+}
+
+void AMusicZone::CancelLoad()
+{
+    if (!LoadFuture.IsValid() && !PlaylistTask.IsValid())
+        return;
+
+    //The decoders, the source hash and the cache copy check this between blocks, so waiting here only costs the block that is currently being
+    //worked on (at most 16 MB of hashing or one 2-4 MB chunk of cache I/O)
+    bCancelLoad = true;
+    ++LoadGeneration;
+    if (LoadFuture.IsValid())
+    {
+        LoadFuture.Wait();
+        LoadFuture = TFuture<void>();
+    }
+    if (PlaylistTask.IsValid())
+    {
+        PlaylistTask.Wait();
+        PlaylistTask = UE::Tasks::TTask<bool>();
+    }
+    bLoading = false;
 }
 
 void AMusicZone::InitDrumFilters()
 {
     //This is to filter and recognize drums and snares from the audio file
-    KickBP.SetBandPass((float)SampleRate, KickCenterHz,  KickQ);
-    SnareBP.SetBandPass((float)SampleRate, SnareCenterHz, SnareQ);
+    //The filters run at the fixed analysis rate, a source that is already below it is analyzed as is
+    EffectiveAnalysisRate = FMath::Min<double>(AnalysisSampleRate, SampleRate);
+    SamplesPerHop = FMath::Max(1, FMath::RoundToInt(AnalysisHopMs * 0.001 * EffectiveAnalysisRate));
+    HopDuration   = double(SamplesPerHop) / EffectiveAnalysisRate;
+    AnalysisDecimator.Init((double)SampleRate, EffectiveAnalysisRate);
+    AnalysisFifo.Reset();
+    AnalysisHopIndex = 0;
+
+    //A progressive start only knows the loudness of its lead here, RenormalizeOnsets switches to the whole song's once it is decoded
+    OnsetEnergyScale = GetOnsetEnergyScale(LoudnessStats);
+
+    KickBP.SetBandPass((float)EffectiveAnalysisRate, KickCenterHz,  KickQ);
+    SnareBP.SetBandPass((float)EffectiveAnalysisRate, SnareCenterHz, SnareQ);
     PrevKickEnergy = PrevSnareEnergy = 0.0f;
     LastKickTime = LastSnareTime = -1000.0;
     bFiltersInited = true;
 }
 
-bool AMusicZone::DecodeWav(const FString& FilePath)
+float AMusicZone::GetOnsetEnergyScale(const FLoudnessStats& Stats) const
 {
-    //FullPCM is the in-memory copy of the entire track uploaded as mono PCM floats. So basically it is a float representing the audio data of that particular instance
-    TArray<uint8> FileData;
-    if (!FFileHelper::LoadFileToArray(FileData, *FilePath))
-        return false;
+    //Band energies scale with the square of the level, so normalizing the detector input to OnsetReferenceLufs is one factor on the energies
+    const float GainDb = Stats.IsValid() ? FMath::Clamp(OnsetReferenceLufs - Stats.IntegratedLufs, -MaxOnsetGainDb, MaxOnsetGainDb) : 0.0f;
+    return bNormalizeOnsetLoudness ? FMath::Pow(10.0f, GainDb / 10.0f) : 1.0f;
+}
 
-    drwav Wav{};
-    if (!drwav_init_memory(&Wav, FileData.GetData(), FileData.Num(), nullptr))
-        return false;
+namespace
+{
+    //Index of the first sample louder than Threshold, or Num if there is none
+    int32 FindFirstSound(const float* Samples, int32 Num, float Threshold)
+    {
+        int32 i = 0;
+        while (i < Num && FMath::Abs(Samples[i]) <= Threshold)
+            ++i;
+        return i;
+    }
 
-    SampleRate = (int32)Wav.sampleRate;
+    //One past the last sample louder than Threshold, or 0 if there is none
+    int32 FindSoundEnd(const float* Samples, int32 Num, float Threshold)
+    {
+        int32 i = Num;
+        while (i > 0 && FMath::Abs(Samples[i - 1]) <= Threshold)
+            --i;
+        return i;
+    }
 
-    TArray<float> Interleaved;
-    Interleaved.SetNumUninitialized((int64)Wav.totalPCMFrameCount * (int32)Wav.channels);
-    drwav_uint64 framesRead = drwav_read_pcm_frames_f32(&Wav, Wav.totalPCMFrameCount, Interleaved.GetData());
-    drwav_uninit(&Wav);
+    //The same over the first End samples of a track, walking back from End a block at a time
+    int64 FindSoundEnd(const FPCMTrack& Track, int64 End, float Threshold)
+    {
+        constexpr int32 BlockSamples = 4096;
+        float Scratch[BlockSamples];
+        while (End > 0)
+        {
+            const int32 Count = (int32)FMath::Min<int64>(BlockSamples, End);
+            const int32 Last = FindSoundEnd(Track.ReadFloat(End - Count, Count, Scratch), Count, Threshold);
+            if (Last > 0)
+                return End - Count + Last;
+            End -= Count;
+        }
+        return 0;
+    }
 
-    if (Wav.channels > 1)
+    //Pulls frames from wherever Dec currently is, one decoded mp3 frame (1152 samples per channel for layer 3) at a time straight out of minimp3's
+    //internal frame buffer, and hands each one to Sink twice: widened and downmixed to mono, and as the decoder's own interleaved int16.
+    //Stops after MaxFrames, at the end of the stream or when bCancel is raised. The time spent widening and downmixing is added to DownmixCycles
+    int64 DecodeMp3Frames(mp3dec_ex_t& Dec, int32 Channels, int64 MaxFrames, const FThreadSafeBool& bCancel, std::atomic<uint64>& DownmixCycles, TFunctionRef<void(const float*, const int16*, int32)> Sink)
     {
-        const int32 Frames = (int32)framesRead;
-        FullPCM.SetNumUninitialized(Frames);
-        for (int32 i = 0; i < Frames; ++i)
+        float Interleaved[MINIMP3_MAX_SAMPLES_PER_FRAME];
+        float Mono[MINIMP3_MAX_SAMPLES_PER_FRAME];
+        mp3dec_frame_info_t FrameInfo{};
+        mp3d_sample_t* Block = nullptr;
+        size_t BlockSamples = 0;
+        int64 Written = 0;
+
+        while (Written < MaxFrames && !bCancel)
         {
-            double sum = 0.0;
-            for (uint32 c = 0; c < Wav.channels; ++c)
-                sum += Interleaved[i * Wav.channels + c];
-            FullPCM[i] = (float)(sum / (double)Wav.channels);
+            const size_t Want = (size_t)FMath::Min<int64>((MaxFrames - Written) * Channels, MINIMP3_MAX_SAMPLES_PER_FRAME);
+            if ((BlockSamples = mp3dec_ex_read_frame(&Dec, &Block, &FrameInfo, Want)) == 0)
+                break;
+
+            const int32 Frames = (int32)(BlockSamples / (size_t)Channels);
+            const uint64 DownmixStart = FPlatformTime::Cycles64();
+            if (Channels == 1)
+            {
+                AudioKernels::Int16ToFloat(Block, Mono, Frames);
+            }
+            else
+            {
+                AudioKernels::Int16ToFloat(Block, Interleaved, Frames * Channels);
+                AudioKernels::DownmixToMono(Interleaved, Mono, Frames, Channels);
+            }
+            DownmixCycles.fetch_add(FPlatformTime::Cycles64() - DownmixStart, std::memory_order_relaxed);
+            Sink(Mono, Block, Frames);
+            Written += Frames;
         }
+        return Written;
+    }
+}
+
+bool AMusicZone::BeginDecode(int64 TotalFrames, int32 InSampleRate, int32 InPlaybackChannels)
+{
+    //Both streams are sized for the whole source once, the part the leading silence would have used is released again by EndDecode.
+    //A playlist song is added behind the one before it instead, which only works for the same rate and layout as the song that is playing
+    if (bAppendingTrack)
+    {
+        if (InSampleRate != SampleRate || InPlaybackChannels != PlaybackChannels || !FullPCM.CanGrowTo(AppendBase + TotalFrames)
+            || !PlaybackPCM.CanGrowTo((AppendBase + TotalFrames) * PlaybackChannels))
+            return false;
+        FullPCM.Extend(AppendBase + TotalFrames);
+        PlaybackPCM.Extend((AppendBase + TotalFrames) * PlaybackChannels);
     }
     else
     {
-        FullPCM = MoveTemp(Interleaved);
+        SampleRate = InSampleRate;
+        PlaybackChannels = InPlaybackChannels;
+
+        //An endless mix starts out empty and grows block by block in AppendDecoded, the window never holds more than the lead
+        if (bEndlessMix)
+        {
+            FullPCM.SetGrowLimit(FMath::Max(FullPCM.GetGrowLimit(), TotalFrames));
+            PlaybackPCM.SetGrowLimit(FMath::Max(PlaybackPCM.GetGrowLimit(), TotalFrames * PlaybackChannels));
+        }
+        FullPCM.Allocate(GetPCMStorage(), bEndlessMix ? 0 : TotalFrames);
+        PlaybackPCM.Allocate(EPCMStorage::Int16, bEndlessMix ? 0 : TotalFrames * PlaybackChannels);
     }
+    PlaybackDither.Seed((uint32)FPlatformTime::Cycles());
+    Loudness.Init(SampleRate);
+    DecodeWritten      = 0;
+    SoundEnd           = 0;
+    LeadingTrimFrames  = 0;
+    TrailingTrimFrames = 0;
     return true;
 }
 
-bool AMusicZone::DecodeMp3(const FString& FilePath)
+template <typename SampleType>
+void AMusicZone::AppendDecoded(const float* Mono, const SampleType* Playback, int32 Frames, int64 TotalFrames)
 {
-    mp3dec_ex_t MP3{};
-    if (mp3dec_ex_open(&MP3, TCHAR_TO_ANSI(*FilePath), MP3D_SEEK_TO_SAMPLE))
+    //Leading silence is counted and dropped, the track starts at the first sample above the threshold
+    int32 First = 0;
+    if (bTrimSilence && DecodeWritten == 0)
+    {
+        First = FindFirstSound(Mono, Frames, GetSilenceThreshold());
+        LeadingTrimFrames += First;
+        if (First == Frames)
+            return;
+    }
+
+    //Silence is found on the mono stream and the playback stream follows it frame for frame
+    const int32 Count = Frames - First;
+    if (bEndlessMix && !bAppendingTrack)
+    {
+        const int64 End = AppendBase + DecodeWritten + Count;
+        if (!WaitForStreamWindow(End))
+            return;
+        FullPCM.Extend(End);
+        PlaybackPCM.Extend(End * PlaybackChannels);
+    }
+    FullPCM.Write(AppendBase + DecodeWritten, Mono + First, Count);
+    WritePlayback(AppendBase + DecodeWritten, Playback + (int64)First * PlaybackChannels, Count);
+    Loudness.Process(Mono + First, Count);
+
+    //Trailing silence has to be written since more sound may follow it, but it is only published once that happens.
+    //That way whatever EndDecode cuts off in the end was never queued or analyzed
+    const int32 Last = bTrimSilence ? FindSoundEnd(Mono + First, Count, GetSilenceThreshold()) : Count;
+    if (Last > 0)
+        SoundEnd = DecodeWritten + Last;
+    DecodeWritten += Count;
+
+    PublishDecoded(bTrimSilence ? SoundEnd : DecodeWritten, TotalFrames - LeadingTrimFrames);
+}
+
+int64 AMusicZone::GetDecodeLeadFrames() const
+{
+    //The notes need the analysis a travel time ahead of what is heard, so the lead never drops below that
+    return (int64)(FMath::Max(StreamLeadSec, TravelTime + 2.0f) * SampleRate);
+}
+
+bool AMusicZone::WaitForStreamWindow(int64 End)
+{
+    //Runs on the load worker. Nothing waits until the progressive start has gone out, the feed is still at 0 before that
+    const int64 Lead = GetDecodeLeadFrames();
+    ReleaseStreamWindow();
+    while (!bCancelLoad && bStartDispatched && End - QueuedFrames.load(std::memory_order_relaxed) > Lead)
+    {
+        FPlatformProcess::Sleep(0.01f);
+        ReleaseStreamWindow();
+    }
+    return !bCancelLoad;
+}
+
+void AMusicZone::TickStreamWindow()
+{
+    //Chunks go back whole, so the window is the lead plus the keep-behind plus up to one chunk on either end.
+    //Only chunks below both consumers' cursors are freed. StreamBlock stores QueuedFrames (release) after it has copied the block into the
+    //wave or the stretch, AnalyzeHop stores AnalyzedFrames (release) after it has read its hop, so the acquire loads here see every read
+    //below those cursors as finished. The release itself changes the size of the streams, which only the load worker may do while it
+    //extends them, so this only hands the position over (release again, so the worker's acquire inherits the two above)
+    const int64 Behind = FMath::Min(QueuedFrames.load(std::memory_order_acquire), AnalyzedFrames.load(std::memory_order_acquire))
+        - (int64)(StreamKeepBehindSec * SampleRate);
+    if (Behind > 0)
+        RequestedReleaseFrame.store(Behind, std::memory_order_release);
+}
+
+void AMusicZone::ReleaseStreamWindow()
+{
+    //Runs on the load worker, between two Extends. Once the decode is done nothing is extended or released any more, what is left resident
+    //is at most the lead and the keep-behind
+    const int64 Behind = RequestedReleaseFrame.load(std::memory_order_acquire);
+    if (Behind <= 0)
+        return;
+
+    FullPCM.ReleaseBefore(Behind);
+    PlaybackPCM.ReleaseBefore(Behind * PlaybackChannels);
+}
+
+void AMusicZone::WritePlayback(int64 Frame, const float* Src, int32 Frames)
+{
+    PlaybackPCM.Write(Frame * PlaybackChannels, Src, Frames * PlaybackChannels, bDitherPlayback ? &PlaybackDither : nullptr);
+}
+
+void AMusicZone::WritePlayback(int64 Frame, const int16* Src, int32 Frames)
+{
+    PlaybackPCM.Write(Frame * PlaybackChannels, Src, Frames * PlaybackChannels);
+}
+
+void AMusicZone::EndDecode()
+{
+    const int64 Kept = bTrimSilence ? SoundEnd : DecodeWritten;
+    TrailingTrimFrames = DecodeWritten - Kept;
+    FullPCM.Truncate(AppendBase + Kept);
+    PlaybackPCM.Truncate((AppendBase + Kept) * PlaybackChannels);
+}
+
+bool AMusicZone::DecodeWav(const FAudioIngest& Source)
+{
+    //FullPCM is the mono analysis copy of the track, kept as floats or as int16 when the zone uses compact storage, PlaybackPCM the int16 stream that is played
+    //dr_wav parses the ingested bytes in place, which are usually a mapping of the file
+    const uint8* Bytes = Source.GetData();
+    const int64 NumBytes = Source.Num();
+
+    drwav Wav{};
+    if (!drwav_init_memory(&Wav, Bytes, (size_t)NumBytes, nullptr))
         return false;
 
-    SampleRate = (int32)MP3.info.hz;
-    const int32 Channels = (int32)MP3.info.channels;
-    const int64 TotalSamples = (int64)MP3.samples;
+    const int32 Rate        = (int32)Wav.sampleRate;
+    const int32 Channels    = (int32)Wav.channels;
+    const int64 TotalFrames = (int64)Wav.totalPCMFrameCount;
+    if (Rate <= 0 || Channels <= 0)
+    {
+        drwav_uninit(&Wav);
+        return false;
+    }
 
-    TArray<mp3d_sample_t> PCM16;
-    PCM16.SetNumUninitialized(TotalSamples);
-    int64 ReadCount = mp3dec_ex_read(&MP3, PCM16.GetData(), MP3.samples);
-    mp3dec_ex_close(&MP3);
+    //A mono 32-bit float WAV already is the samples both streams want, so they are written straight from the mapping without going through dr_wav's converter
+    const bool bRawMonoFloat = Channels == 1
+        && Wav.translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT
+        && Wav.bitsPerSample == 32
+        && Wav.dataChunkDataPos + (uint64)TotalFrames * sizeof(float) <= (uint64)NumBytes;
+
+    if (bRawMonoFloat)
+    {
+        //Write takes 32-bit block sizes, so a very long file goes in a chunk at a time. An endless mix takes smaller steps to stay inside its lead
+        const float* Src = reinterpret_cast<const float*>(Bytes + Wav.dataChunkDataPos);
+        const int64 Step = bEndlessMix ? 65536 : FPCMTrack::ChunkSamples;
+        if (!BeginDecode(TotalFrames, Rate, 1))
+        {
+            drwav_uninit(&Wav);
+            return false;
+        }
+        for (int64 Done = 0; Done < TotalFrames && !bCancelLoad; Done += Step)
+            AppendDecoded(Src + Done, Src + Done, (int32)FMath::Min<int64>(Step, TotalFrames - Done), TotalFrames);
+        EndDecode();
+        drwav_uninit(&Wav);
+        return FullPCM.Num() > AppendBase;
+    }
+
+    //Everything else is pulled through dr_wav a fixed block of frames at a time and downmixed as it arrives, so only one block of interleaved floats is ever alive.
+    //Mono and stereo blocks are played as they are, surround is folded down to stereo first.
+    //Both streams are sized once up front and never reallocated while decoding, so the analysis and playback can already read below the decoded watermark
+    constexpr int32 BlockFrames = 4096;
+    TScopedScratch<float> Block(ScratchPool.Get(), BlockFrames * Channels);
+    TScopedScratch<float> Mono(ScratchPool.Get(), BlockFrames);
+    TScopedScratch<float> Stereo(ScratchPool.Get(), Channels > 2 ? BlockFrames * 2 : 0);
+    if (!BeginDecode(TotalFrames, Rate, FMath::Min(Channels, 2)))
+    {
+        drwav_uninit(&Wav);
+        return false;
+    }
+
+    int64 Written = 0;
+    drwav_uint64 FramesRead = 0;
+    while (!bCancelLoad && Written < TotalFrames
+        && (FramesRead = drwav_read_pcm_frames_f32(&Wav, (drwav_uint64)FMath::Min<int64>(BlockFrames, TotalFrames - Written), Block.GetData())) > 0)
+    {
+        const uint64 DownmixStart = FPlatformTime::Cycles64();
+        AudioKernels::DownmixToMono(Block.GetData(), Mono.GetData(), (int32)FramesRead, Channels);
+        if (Channels > 2)
+            AudioKernels::DownmixToStereo(Block.GetData(), Stereo.GetData(), (int32)FramesRead, Channels);
+        DownmixCycles.fetch_add(FPlatformTime::Cycles64() - DownmixStart, std::memory_order_relaxed);
+        AppendDecoded(Mono.GetData(), Channels > 2 ? Stereo.GetData() : Block.GetData(), (int32)FramesRead, TotalFrames);
+        Written += (int64)FramesRead;
+    }
+    EndDecode();
+
+    drwav_uninit(&Wav);
+    return FullPCM.Num() > AppendBase;
+}
 
-    if (ReadCount <= 0) return false;
 
-    TArray<float> Interleaved;
-    Interleaved.SetNumUninitialized(ReadCount);
-    for (int64 i = 0; i < ReadCount; ++i)
-        Interleaved[i] = (float)PCM16[i] / 32768.0f;
+bool AMusicZone::DecodeMp3(const FAudioIngest& Source)
+{
+    //minimp3 decodes straight out of the ingested bytes, so the only decoded audio we hold besides the two streams is the one frame minimp3 keeps internally
+    bDecodedParallel = false;
+    mp3dec_ex_t MP3{};
+    if (mp3dec_ex_open_buf(&MP3, Source.GetData(), (size_t)Source.Num(), MP3D_SEEK_TO_SAMPLE))
+        return false;
 
-    if (Channels > 1)
+    const int32 Rate        = (int32)MP3.info.hz;
+    const int32 Channels    = (int32)MP3.info.channels;
+    const int64 TotalFrames = Channels > 0 ? (int64)(MP3.samples / (uint64)Channels) : 0;
+    if (Rate <= 0 || Channels <= 0 || TotalFrames <= 0)
     {
-        const int32 Frames = (int32)(ReadCount / Channels);
-        FullPCM.SetNumUninitialized(Frames);
-        for (int32 i = 0; i < Frames; ++i)
+        mp3dec_ex_close(&MP3);
+        return false;
+    }
+
+    //Long tracks are split across the task graph workers. If a shard fails for any reason we still have the serial path below to fall back on.
+    //Playlist songs are fetched in the background while another one plays, so they stay serial and off the workers
+    const int32 NumShards = FMath::Clamp(FTaskGraphInterface::Get().GetNumWorkerThreads(), 1, MaxMp3DecodeShards);
+    if (bParallelMp3Decode && !bProgressiveLoad && !bAppendingTrack && NumShards > 1 && TotalFrames >= (int64)(ParallelMp3MinSeconds * Rate))
+    {
+        SampleRate = Rate;
+        if (DecodeMp3Parallel(Source, Channels, TotalFrames, NumShards))
         {
-            double sum = 0.0;
-            for (int32 c = 0; c < Channels; ++c)
-                sum += Interleaved[i * Channels + c];
-            FullPCM[i] = (float)(sum / (double)Channels);
+            mp3dec_ex_close(&MP3);
+            bDecodedParallel = true;
+            return true;
         }
+        if (bCancelLoad)
+        {
+            mp3dec_ex_close(&MP3);
+            return false;
+        }
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Parallel mp3 decode failed, falling back to serial decode"));
     }
-    else
+
+    //Stream the track block by block straight into both streams instead of materializing the whole int16 and float track first. MP3 has
+    //at most two channels, so the decoder's int16 output is the playback stream as it is.
+    //The streams are sized once so the blocks below the decoded watermark can already be read while the rest is still coming in
+    if (!BeginDecode(TotalFrames, Rate, Channels))
     {
-        FullPCM = MoveTemp(Interleaved);
+        mp3dec_ex_close(&MP3);
+        return false;
     }
-    return true;
+    const int64 Written = DecodeMp3Frames(MP3, Channels, TotalFrames, bCancelLoad, DownmixCycles, [this, TotalFrames](const float* Mono, const int16* Interleaved, int32 Frames)
+    {
+        AppendDecoded(Mono, Interleaved, Frames, TotalFrames);
+    });
+    EndDecode();
+
+    if (MP3.last_error)
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] mp3 decode stopped early (error %d) after %lld frames"), MP3.last_error, Written);
+
+    mp3dec_ex_close(&MP3);
+    return FullPCM.Num() > AppendBase;
 }
 
-USoundWaveProcedural* AMusicZone::CreateProceduralFromPCM(const TArray<float>& PCM, int32 InSampleRate)
+bool AMusicZone::DecodeMp3Parallel(const FAudioIngest& Source, int32 Channels, int64 TotalFrames, int32 NumShards)
 {
-    TArray<int16> PCM16;
-    PCM16.SetNumUninitialized(PCM.Num());
-    for (int32 i = 0; i < PCM.Num(); ++i)
+    //Shards are sized in whole layer 3 frames (1152 samples, MPEG-2's 576 divides it as well)
+    constexpr int64 FrameAlign   = 1152;
+    constexpr int64 WarmupFrames = 2 * FrameAlign;
+
+    //The shards write to fixed offsets, so the leading silence has to be known before they start. It is found by decoding from the top
+    //one frame at a time until the first sample above the threshold, which for a normal song is a handful of frames
+    int64 Lead = 0;
+    if (bTrimSilence)
     {
-        //This is for safety to keep the values within normal range
-        float v = FMath::Clamp(PCM[i], -1.0f, 1.0f);
-        PCM16[i] = (int16)FMath::RoundToInt(v * 32767.0f);
+        mp3dec_ex_t Scan{};
+        if (mp3dec_ex_open_buf(&Scan, Source.GetData(), (size_t)Source.Num(), MP3D_SEEK_TO_SAMPLE))
+            return false;
+
+        const float Threshold = GetSilenceThreshold();
+        bool bFoundSound = false;
+        while (!bFoundSound && !bCancelLoad && Lead < TotalFrames)
+        {
+            const int64 Scanned = DecodeMp3Frames(Scan, Channels, FrameAlign, bCancelLoad, DownmixCycles, [&](const float* Mono, const int16*, int32 Frames)
+            {
+                if (bFoundSound)
+                    return;
+                const int32 First = FindFirstSound(Mono, Frames, Threshold);
+                Lead += First;
+                bFoundSound = First < Frames;
+            });
+            if (Scanned == 0)
+                break;
+        }
+        mp3dec_ex_close(&Scan);
     }
 
-    //Create a procedural sound and tell it what values we're about to feed to it
+    const int64 KeptFrames  = TotalFrames - Lead;
+    const int64 ShardFrames = Align(FMath::DivideAndRoundUp<int64>(FMath::Max<int64>(KeptFrames, 1), NumShards), FrameAlign);
+    NumShards = (int32)FMath::DivideAndRoundUp<int64>(FMath::Max<int64>(KeptFrames, 1), ShardFrames);
+
+    FullPCM.Allocate(GetPCMStorage(), KeptFrames);
+    PlaybackChannels = Channels;
+    PlaybackPCM.Allocate(EPCMStorage::Int16, KeptFrames * Channels);
+    LeadingTrimFrames = Lead;
+
+    TArray<int64> ShardWritten;
+    ShardWritten.SetNumZeroed(NumShards);
+    TArray<FLoudnessMeter> ShardLoudness;
+    ShardLoudness.SetNum(NumShards);
+    std::atomic<int64> FramesDone { 0 };
+
+    ParallelFor(NumShards, [&](int32 Shard)
+    {
+        //Every shard has its own decoder over the same read-only buffer, minimp3 keeps no shared state between them
+        mp3dec_ex_t Dec{};
+        if (mp3dec_ex_open_buf(&Dec, Source.GetData(), (size_t)Source.Num(), MP3D_SEEK_TO_SAMPLE))
+            return;
+
+        //Start and End are source frames, the track position is Lead frames behind them
+        const int64 Start = Lead + Shard * ShardFrames;
+        const int64 End   = FMath::Min(Start + ShardFrames, TotalFrames);
+
+        //A layer 3 frame can borrow its main data from the bit reservoir of up to 511 bytes of earlier frames, and the synthesis filterbank
+        //and IMDCT overlap carry state across frames. mp3dec_ex_seek already backs up far enough to refill the reservoir and pre-decodes a couple of frames,
+        //on top of that we start WarmupFrames early and throw that audio away so the shard edge decodes exactly like the serial path does
+        //The warm-up audio belongs to the previous shard's range, so it is thrown away instead of being written to FullPCM
+        const int64 WarmStart = FMath::Max<int64>(0, Start - WarmupFrames);
+        if (mp3dec_ex_seek(&Dec, (uint64)WarmStart * (uint64)Channels) == 0)
+        {
+            const int64 Discard = Start - WarmStart;
+            const int64 Skipped = Discard > 0
+                ? DecodeMp3Frames(Dec, Channels, Discard, bCancelLoad, DownmixCycles, [](const float*, const int16*, int32) {})
+                : 0;
+
+            if (Skipped == Discard)
+            {
+                int64 Offset = Start - Lead;
+                FLoudnessMeter& Meter = ShardLoudness[Shard];
+                Meter.Init(SampleRate);
+                ShardWritten[Shard] = DecodeMp3Frames(Dec, Channels, End - Start, bCancelLoad, DownmixCycles, [this, &Offset, &Meter, &FramesDone, Channels, TotalFrames](const float* Mono, const int16* Interleaved, int32 Frames)
+                {
+                    FullPCM.Write(Offset, Mono, Frames);
+                    PlaybackPCM.Write(Offset * Channels, Interleaved, Frames * Channels);
+                    Meter.Process(Mono, Frames);
+                    Offset += Frames;
+                    const int64 Done = FramesDone.fetch_add(Frames, std::memory_order_relaxed) + Frames;
+                    LoadProgress.store((float)((double)Done / (double)TotalFrames), std::memory_order_relaxed);
+                });
+            }
+        }
+        mp3dec_ex_close(&Dec);
+    });
+
+    if (bCancelLoad)
+        return false;
+
+    //Every shard but the last has to fill its whole range for the stitched result to match the serial decode, the last one may end early like the serial path would
+    for (int32 Shard = 0; Shard < NumShards - 1; ++Shard)
+    {
+        if (ShardWritten[Shard] != FMath::Min((Shard + 1) * ShardFrames, KeptFrames) - Shard * ShardFrames)
+            return false;
+    }
+
+    //The trailing silence can only be found once everything is decoded. Nothing reads the track yet, so it is simply cut off here
+    const int64 Decoded = (NumShards - 1) * ShardFrames + ShardWritten.Last();
+    FullPCM.Truncate(bTrimSilence ? FindSoundEnd(FullPCM, Decoded, GetSilenceThreshold()) : Decoded);
+    PlaybackPCM.Truncate(FullPCM.Num() * Channels);
+    TrailingTrimFrames = Decoded - FullPCM.Num();
+
+    Loudness = ShardLoudness[0];
+    for (int32 Shard = 1; Shard < NumShards; ++Shard)
+        Loudness.Merge(ShardLoudness[Shard]);
+    return FullPCM.Num() > 0;
+}
+
+USoundWaveProcedural* AMusicZone::CreateProceduralFromPCM(int32 InSampleRate)
+{
+    //Create a procedural sound and tell it what values we're about to feed to it. Nothing is queued up front, the wave asks for each
+    //block through its underflow callback once the mixer has drained what it holds
     USoundWaveProcedural* SW = NewObject<USoundWaveProcedural>(this);
     SW->SetSampleRate(InSampleRate);
-    SW->NumChannels = 1;
-    SW->Duration = (float)PCM.Num() / (float)InSampleRate;
+    SW->NumChannels = PlaybackChannels;
+    SW->Duration = (float)GetPlayedDuration();
     SW->SoundGroup = ESoundGroup::SOUNDGROUP_Default;
     SW->bLooping = false;
-
-    //Push the raw bytes of the int16 buffer into the sound's queue so it can play immediately
-    SW->QueueAudio(reinterpret_cast<const uint8*>(PCM16.GetData()), PCM16.Num() * sizeof(int16));
+    SW->OnSoundWaveProceduralUnderflow = FOnSoundWaveProceduralUnderflow::CreateUObject(this, &AMusicZone::OnStreamUnderflow);
     return SW;
 }
 
+void AMusicZone::OnStreamUnderflow(USoundWaveProcedural* SW, int32 SamplesRequired)
+{
+    //Runs on the audio render thread. The mixer counts samples of all channels, the stream is fed in frames
+    FScopeLock Lock(&StreamLock);
+    if (!bStreaming)
+        return;
+
+    const int32 FramesRequired = SamplesRequired / PlaybackChannels;
+    StreamBlock(SW, FramesRequired);
+
+    //Right after this the mixer takes FramesRequired out of what the wave holds. That is only a clock reading while it gets all of it,
+    //a starved stream (decode behind, or past the end) leaves the clock running freely instead of holding it back
+    const int32 Held = SW->GetAvailableAudioByteCount() / (int32)(sizeof(int16) * PlaybackChannels);
+    if (Held >= FramesRequired)
+        SongClock.Observe(WaveFrames - Held + FramesRequired, FPlatformTime::Seconds());
+}
+
+void AMusicZone::StreamBlock(USoundWaveProcedural* SW, int32 FramesRequired)
+{
+    //Tops the wave up to StreamAheadFrames, or to whatever the mixer asked for if that is more. A progressive load that is still
+    //decoding only hands out what is below the watermark, the next callback picks up the rest
+    const int64 Cursor    = QueuedFrames.load(std::memory_order_relaxed);
+    const int64 Available = DecodedFrames.load(std::memory_order_acquire);
+    const int32 Held      = SW->GetAvailableAudioByteCount() / (int32)(sizeof(int16) * PlaybackChannels);
+    const int32 Target    = FMath::Min(FMath::Max(FramesRequired, StreamAheadFrames), StreamScratch.Num() / PlaybackChannels);
+
+    if (Stretch.IsActive())
+    {
+        StreamStretched(SW, Target - Held, Cursor, Available);
+        return;
+    }
+
+    const int32 Count     = (int32)FMath::Min<int64>(Target - Held, Available - Cursor);
+    if (Count <= 0)
+        return;
+
+    //The playback stream is int16 already, so a block inside one chunk is queued straight from the track and only one that straddles a
+    //chunk boundary is gathered into StreamScratch
+    const int16* Samples = PlaybackPCM.ReadInt16(Cursor * PlaybackChannels, Count * PlaybackChannels, StreamScratch.GetData());
+    SW->QueueAudio(reinterpret_cast<const uint8*>(Samples), Count * PlaybackChannels * sizeof(int16));
+    QueuedFrames.store(Cursor + Count, std::memory_order_release);
+    WaveFrames += Count;
+}
+
+void AMusicZone::StreamStretched(USoundWaveProcedural* SW, int32 Count, int64 Cursor, int64 Available)
+{
+    //The stretch is handed source frames only as its hops ask for them, so QueuedFrames still says how much of the track is consumed
+    //and the window, the playlist and the decode lead keep working on source frames
+    int32 Made = 0;
+    while (Made < Count)
+    {
+        Made += Stretch.Pull(StreamScratch.GetData() + Made * PlaybackChannels, Count - Made);
+        const int32 Need = (int32)FMath::Min<int64>(Stretch.GetInputNeeded(), Available - Cursor);
+        if (Made >= Count || Stretch.IsFinished())
+            break;
+
+        if (Need <= 0)
+        {
+            //Past the last frame of the last track the stretch is told so and plays out the segment it still holds, otherwise the song
+            //would end up to a segment short of SongDuration / speed. The watermark is read again after the flag, which is set after it
+            if (!bDecodeComplete || bMoreTracksComing || Cursor < DecodedFrames.load(std::memory_order_acquire))
+                break;
+            Stretch.Finish();
+            continue;
+        }
+
+        Stretch.Push(PlaybackPCM.ReadInt16(Cursor * PlaybackChannels, Need * PlaybackChannels, StretchScratch.GetData()), Need);
+        Cursor += Need;
+        QueuedFrames.store(Cursor, std::memory_order_release);
+    }
+
+    if (Made <= 0)
+        return;
+
+    SW->QueueAudio(reinterpret_cast<const uint8*>(StreamScratch.GetData()), Made * PlaybackChannels * sizeof(int16));
+    WaveFrames += Made;
+}
+
 void AMusicZone::StartSong()
 {
-    ProcWave = CreateProceduralFromPCM(FullPCM, SampleRate);
+    ProcWave = CreateProceduralFromPCM(SampleRate);
+    {
+        //The scratch is borrowed from the pool once here so the render thread never allocates, and StopAndReset gives it back. Twice the
+        //lead leaves room for a mixer that asks for more at once. The first block is primed so the first buffer the mixer renders already
+        //has the song in it
+        FScopeLock Lock(&StreamLock);
+        StreamAheadFrames = FMath::Max(FMath::RoundToInt(StreamAheadMs * 0.001f * (float)SampleRate), 256);
+        StreamScratch.Borrow(ScratchPool.Get(), StreamAheadFrames * 2 * PlaybackChannels);
+        QueuedFrames.store(0, std::memory_order_relaxed);
+        WaveFrames = 0;
+        Stretch.Init(SampleRate, PlaybackChannels, (float)(1.0 / TimeScale));
+        if (Stretch.IsActive())
+            StretchScratch.Borrow(ScratchPool.Get(), Stretch.GetMaxInputNeeded() * PlaybackChannels);
+        SongClock.Reset(SampleRate);
+        SongClockBase = 0.0;
+        bStreaming = true;
+        StreamBlock(ProcWave, StreamAheadFrames);
+    }
+
     AudioComp = UGameplayStatics::SpawnSound2D(this, ProcWave, 1.0f, 1.0f, 0.0f);
     if (!AudioComp)
     {
@@ -298,38 +1260,213 @@ void AMusicZone::StartSong()
     bSongStarted  = true;
     bSongFinished = false;
 
-    GetWorld()->GetTimerManager().SetTimer(
-        SongEndHandle,
-        FTimerDelegate::CreateLambda([this]()
+    StartKeysoundClock();
+}
+
+bool AMusicZone::SeekToTime(float SongSeconds)
+{
+    if (!bSongStarted || bCalibrating || !ProcWave)
+        return false;
+
+    //Only audio that is decoded and still resident can be played and analyzed, an endless mix has released what lies behind its window
+    const int64 Target    = (int64)(FMath::Max(SongSeconds, 0.0f) * SampleRate);
+    const int64 Watermark = DecodedFrames.load(std::memory_order_acquire);
+    if (Target >= Watermark || Target < FullPCM.GetFirstResident())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Cannot seek to %.2fs, only %.2fs to %.2fs is decoded and resident"),
+            SongSeconds, (double)FullPCM.GetFirstResident() / SampleRate, (double)Watermark / SampleRate);
+        return false;
+    }
+
+    //From here on the worker is stopped, so the analysis state, the checkpoints and the prompt queue belong to this thread
+    const double SeekStart = FPlatformTime::Seconds();
+    bAnalyzing = false;
+    if (AnalysisFuture.IsValid())
+    {
+        AnalysisFuture.Wait();
+        AnalysisFuture = TFuture<void>();
+    }
+
+    int32 From = Checkpoints.Num() - 1;
+    while (From >= 0 && (Checkpoints[From].CursorSamples > Target || Checkpoints[From].CursorSamples < FullPCM.GetFirstResident()))
+        --From;
+    if (From < 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Cannot seek to %.2fs, there is no analysis checkpoint before it"), SongSeconds);
+        StartContinuousAnalysis();
+        return false;
+    }
+
+    //The catch-up below runs on the calling thread, so it is bounded to one checkpoint interval (plus the hop a checkpoint can land late).
+    //A target further away than that is past what the analysis has reached so far, and is refused instead of analyzing up to it here
+    const int32 HopIn = GetSourceSamplesPerHop();
+    const int64 MaxCatchUp = (int64)(AnalysisCheckpointSec * SampleRate) + HopIn;
+    if (Target - Checkpoints[From].CursorSamples > MaxCatchUp)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Cannot seek to %.2fs, the analysis has only reached %.2fs so far"),
+            SongSeconds, (double)AnalysisCursorSamples / SampleRate);
+        StartContinuousAnalysis();
+        return false;
+    }
+
+    //The checkpoints after the restored one are taken again as the analysis gets there
+    const int64 CheckpointSamples = Checkpoints[From].CursorSamples;
+    RestoreCheckpoint(Checkpoints[From]);
+    Checkpoints.SetNum(From + 1, false);
+    NextCheckpointSamples = CheckpointSamples + FMath::Max<int64>(1, (int64)(AnalysisCheckpointSec * SampleRate));
+
+    //Up to the target the analysis only has to bring the detector state along, its prompts are before the new window. After it, a travel time
+    //and a bit is analyzed right away so the notes that are already on the lane at the target are there in the first frame
+    TScopedScratch<float> HopScratch(ScratchPool.Get(), HopIn);
+    while (AnalysisCursorSamples + HopIn <= Target)
+        AnalyzeHop(HopScratch.GetData(), HopIn);
+    PromptBuffer.Empty();
+
+    const int64 PreRollEnd = FMath::Min<int64>(Target + (int64)((TravelTime / TimeScale + 1.0) * SampleRate), Watermark);
+    while (AnalysisCursorSamples + HopIn <= PreRollEnd)
+        AnalyzeHop(HopScratch.GetData(), HopIn);
+
+    for (FActiveNote& N : ActiveNotes)
+    {
+        if (N.Actor.IsValid())
+            N.Actor->Destroy();
+    }
+    ActiveNotes.Reset();
+    Upcoming.Reset();
+
+    //The wave drops what it holds on its next render and underflows straight away, so the first block from the target comes from the
+    //callback as usual. The clock starts over there, counting on from the target's played time
+    {
+        FScopeLock Lock(&StreamLock);
+        ProcWave->ResetAudio();
+        QueuedFrames.store(Target, std::memory_order_release);
+        WaveFrames = 0;
+        Stretch.Reset();
+        SongClock.Reset(SampleRate);
+        SongClockBase = (double)Target / SampleRate * TimeScale;
+        SongStartTime = FPlatformTime::Seconds();
+    }
+
+    StartContinuousAnalysis();
+
+    UE_LOG(LogTemp, Log, TEXT("[MZDBG] Seeked to %.2fs from the checkpoint at %.2fs, analyzed %.2fs of song in %.2f ms"),
+        SongSeconds, (double)CheckpointSamples / SampleRate, (double)(AnalysisCursorSamples - CheckpointSamples) / SampleRate,
+        (FPlatformTime::Seconds() - SeekStart) * 1000.0);
+    return true;
+}
+
+void AMusicZone::CreateKeysoundPool()
+{
+    //Non-spatialized 2D voices owned by the zone. They are registered once here and only ever have their sound swapped and restarted
+    for (int32 i = 0; i < KeysoundVoices; ++i)
+    {
+        UAudioComponent* Voice = NewObject<UAudioComponent>(this);
+        Voice->bAutoActivate = false;
+        Voice->bAutoDestroy  = false;
+        Voice->bAllowSpatialization = false;
+        Voice->bIsUISound    = true;
+        Voice->SetupAttachment(Root);
+        Voice->RegisterComponent();
+        KeysoundPool.Add(Voice);
+    }
+}
+
+void AMusicZone::StartKeysoundClock()
+{
+    UQuartzSubsystem* Quartz = UQuartzSubsystem::Get(GetWorld());
+    if (!Quartz || KeysoundPool.Num() == 0)
+        return;
+
+    //The clock only exists so keysounds are started by the audio renderer instead of the game thread. It runs for as long as the song does
+    //and a command with no quantization executes at the start of the next buffer it renders. That never looks at the clock's tempo, so it
+    //keeps the default settings: the clock is buffer-aligned, not beat-aligned, and its bars and beats mean nothing for the song
+    const FName ClockName(*FString::Printf(TEXT("Keysounds_%s"), *GetName()));
+    KeysoundClock = Quartz->CreateNewClock(this, ClockName, FQuartzClockSettings(), /*bOverrideSettingsIfClockExists=*/true);
+    if (KeysoundClock)
+        KeysoundClock->StartClock(this, KeysoundClock);
+}
+
+void AMusicZone::StopKeysoundClock()
+{
+    for (UAudioComponent* Voice : KeysoundPool)
+    {
+        if (Voice)
+            Voice->Stop();
+    }
+
+    if (!KeysoundClock)
+        return;
+
+    KeysoundClock->StopClock(this, /*CancelPendingEvents=*/true, KeysoundClock);
+    if (UQuartzSubsystem* Quartz = UQuartzSubsystem::Get(GetWorld()))
+        Quartz->DeleteClockByHandle(this, KeysoundClock);
+    KeysoundClock = nullptr;
+}
+
+void AMusicZone::PlayKeysound(USoundBase* Sound)
+{
+    if (!Sound || KeysoundPool.Num() == 0)
+        return;
+
+    //A free voice if there is one, otherwise the round-robin slot, which is the one that was started longest ago
+    UAudioComponent* Voice = KeysoundPool[NextKeysoundVoice];
+    for (int32 i = 0; i < KeysoundPool.Num(); ++i)
+    {
+        const int32 Index = (NextKeysoundVoice + i) % KeysoundPool.Num();
+        if (!KeysoundPool[Index]->IsPlaying())
         {
-            bSongFinished = true;
-            bSongStarted = false;
-            bAnalyzing    = false;
-            StopAndReset();
-        }),
-        (float)SongDuration + 1.0f, false
-    );
+            Voice = KeysoundPool[Index];
+            NextKeysoundVoice = Index;
+            break;
+        }
+    }
+    NextKeysoundVoice = (NextKeysoundVoice + 1) % KeysoundPool.Num();
+
+    if (Voice->Sound != Sound)
+        Voice->SetSound(Sound);
+
+    if (KeysoundClock)
+    {
+        //None means the next audio buffer, not the next beat
+        FQuartzQuantizationBoundary NextBuffer(EQuartzCommandQuantization::None);
+        Voice->PlayQuantized(this, KeysoundClock, NextBuffer, FOnQuartzCommandEventBP());
+    }
+    else
+    {
+        Voice->Play();
+    }
 }
 
-void AMusicZone::PreRollAnalysis()
+double AMusicZone::GetSongTime() const
 {
-    const int32 Total = FullPCM.Num();
-    HopDuration = double(SamplesPerHop) / double(SampleRate);
+    //Without the fallback a device that never renders (-nosound, a lost output) would hold the song at 0 forever
+    const double Now = FPlatformTime::Seconds();
+    if (!SongClock.HasStarted() && Now - SongStartTime > 1.0)
+        return SongClockBase + (Now - SongStartTime);
+    return SongClockBase + SongClock.GetSeconds(Now);
+}
 
-    double TimeSec = 0.0;
-    const int32 HopsToFeed = FMath::Min<int32>((int32)(8.0 / HopDuration), Total / SamplesPerHop);
+void AMusicZone::PreRollAnalysis()
+{
+    //A progressive load runs this before the whole song is decoded, so it never looks past the decoded watermark
+    const int64 Total    = DecodedFrames.load(std::memory_order_acquire);
+    //A song that starts further in is analyzed up to its start here as well, so the seek in FinishLoad only has a checkpoint's worth left
+    const int64 PreRollEnd = FMath::Min<int64>((int64)((8.0 + StartAtSec) * SampleRate), Total);
+    const int32 HopIn    = GetSourceSamplesPerHop();
 
     PrevEnergy = 0.0f;
     LastOnsetTime = -1000.0;
+    AnalysisCursorSamples = 0;
+    Checkpoints.Reset();
+    NextCheckpointSamples = 0;
+    TrackGains.Reset();
+    NextTrackGain = 0;
 
-    for (int32 h = 0; h < HopsToFeed; ++h)
-    {
-        const int32 Offset = h * SamplesPerHop;
-        ProcessFrameForOnsets(&FullPCM[Offset], SamplesPerHop, TimeSec);
-        TimeSec += HopDuration;
-    }
+    //Compact tracks are widened to float one hop at a time right here, float tracks are read in place
+    TScopedScratch<float> HopScratch(ScratchPool.Get(), HopIn);
 
-    AnalysisCursorSamples = HopsToFeed * SamplesPerHop;
+    while (AnalysisCursorSamples + HopIn <= PreRollEnd)
+        AnalyzeHop(HopScratch.GetData(), HopIn);
 }
 
 void AMusicZone::StartContinuousAnalysis()
@@ -340,20 +1477,30 @@ void AMusicZone::StartContinuousAnalysis()
 
 void AMusicZone::AnalysisWorker()
 {
-    double TimeSec = double(AnalysisCursorSamples) / double(SampleRate);
-    int32 HopCount = 0;
+    const int32 HopIn = GetSourceSamplesPerHop();
+
+    TScopedScratch<float> HopScratch(ScratchPool.Get(), HopIn);
 
     while (bAnalyzing)
     {
-        const int32 NextEnd = AnalysisCursorSamples + SamplesPerHop;
-        if (NextEnd > FullPCM.Num())
-            break;
-
-        ProcessFrameForOnsets(&FullPCM[AnalysisCursorSamples], SamplesPerHop, TimeSec);
+        //The cursor never passes the decoded watermark. If the decoder is still behind we wait for it, once it is done the last partial hop goes in and the song is fully analyzed
+        const int64 Watermark = DecodedFrames.load(std::memory_order_acquire);
+        const int64 NextEnd = AnalysisCursorSamples + HopIn;
+        if (NextEnd > Watermark)
+        {
+            //The end of a playlist song is not the end of the session, the next one is appended behind it
+            if (bDecodeComplete && !bMoreTracksComing)
+            {
+                const int32 Tail = (int32)(Watermark - AnalysisCursorSamples);
+                if (Tail > 0)
+                    AnalyzeHop(HopScratch.GetData(), Tail);
+                break;
+            }
+            FPlatformProcess::Sleep(0.005f);
+            continue;
+        }
 
-        AnalysisCursorSamples = NextEnd;
-        TimeSec += HopDuration;
-        HopCount++;
+        AnalyzeHop(HopScratch.GetData(), HopIn);
 
         if (!bAnalyzing || bSongFinished)
             break;
@@ -362,10 +1509,181 @@ void AMusicZone::AnalysisWorker()
     }
 }
 
+void AMusicZone::AnalyzeHop(float* Scratch, int32 NumSamples)
+{
+    //A playlist song that was just appended hands its gain over here, from its first hop on the detector runs at that song's loudness
+    const int64 TrackStart = NextTrackStartFrame.load(std::memory_order_acquire);
+    if (TrackStart >= 0)
+    {
+        TrackGains.Add({ TrackStart, NextTrackEnergyScale.load(std::memory_order_relaxed) });
+        NextTrackStartFrame.store(-1, std::memory_order_release);
+    }
+    while (NextTrackGain < TrackGains.Num() && AnalysisCursorSamples >= TrackGains[NextTrackGain].Key)
+        OnsetEnergyScale = TrackGains[NextTrackGain++].Value;
+
+    if (AnalysisCursorSamples >= NextCheckpointSamples)
+        SaveCheckpoint();
+
+    FeedAnalysis(FullPCM.ReadFloat(AnalysisCursorSamples, NumSamples, Scratch), NumSamples);
+    AnalysisCursorSamples += NumSamples;
+    AnalyzedFrames.store(AnalysisCursorSamples, std::memory_order_release);
+}
+
+void AMusicZone::SaveCheckpoint()
+{
+    if (!bFiltersInited) { InitDrumFilters(); }
+
+    //An endless mix releases the audio the analysis is StreamKeepBehindSec past, checkpoints in there could never be analyzed on from again.
+    //The bound is worked out here rather than read from the track, whose release runs on the load worker
+    if (bEndlessMix)
+    {
+        const int64 Released = AnalysisCursorSamples - (int64)(StreamKeepBehindSec * SampleRate);
+        int32 NumStale = 0;
+        while (NumStale < Checkpoints.Num() && Checkpoints[NumStale].CursorSamples < Released)
+            ++NumStale;
+        if (NumStale > 0)
+            Checkpoints.RemoveAt(0, NumStale, false);
+    }
+
+    FAnalysisCheckpoint& C = Checkpoints.AddDefaulted_GetRef();
+    C.CursorSamples    = AnalysisCursorSamples;
+    C.HopIndex         = AnalysisHopIndex;
+    C.KickBP           = KickBP;
+    C.SnareBP          = SnareBP;
+    C.Decimator        = AnalysisDecimator;
+    C.Fifo             = AnalysisFifo;
+    C.PrevKickEnergy   = PrevKickEnergy;
+    C.PrevSnareEnergy  = PrevSnareEnergy;
+    C.LastKickTime     = LastKickTime;
+    C.LastSnareTime    = LastSnareTime;
+    C.OnsetEnergyScale = OnsetEnergyScale;
+
+    NextCheckpointSamples = AnalysisCursorSamples + FMath::Max<int64>(1, (int64)(AnalysisCheckpointSec * SampleRate));
+}
+
+void AMusicZone::RestoreCheckpoint(const FAnalysisCheckpoint& Checkpoint)
+{
+    AnalysisCursorSamples = Checkpoint.CursorSamples;
+    AnalysisHopIndex      = Checkpoint.HopIndex;
+    KickBP                = Checkpoint.KickBP;
+    SnareBP               = Checkpoint.SnareBP;
+    AnalysisDecimator     = Checkpoint.Decimator;
+    AnalysisFifo          = Checkpoint.Fifo;
+    PrevKickEnergy        = Checkpoint.PrevKickEnergy;
+    PrevSnareEnergy       = Checkpoint.PrevSnareEnergy;
+    LastKickTime          = Checkpoint.LastKickTime;
+    LastSnareTime         = Checkpoint.LastSnareTime;
+    OnsetEnergyScale      = Checkpoint.OnsetEnergyScale;
+
+    //The gain is the one that was in effect at the checkpoint, the boundaries after it are crossed again
+    NextTrackGain = 0;
+    while (NextTrackGain < TrackGains.Num() && TrackGains[NextTrackGain].Key <= Checkpoint.CursorSamples)
+        ++NextTrackGain;
+}
+
+bool AMusicZone::RestartAnalysisWithGain(float EnergyScale)
+{
+    //The first checkpoint is the detector exactly as InitDrumFilters left it, so going back there with another gain runs the same analysis
+    //a load that knew the gain from the start would have. The prompts made with the old gain are dropped
+    if (Checkpoints.Num() == 0 || Checkpoints[0].CursorSamples != 0 || FullPCM.GetFirstResident() > 0)
+        return false;
+
+    Checkpoints.SetNum(1, false);
+    Checkpoints[0].OnsetEnergyScale = EnergyScale;
+    RestoreCheckpoint(Checkpoints[0]);
+    NextCheckpointSamples = FMath::Max<int64>(1, (int64)(AnalysisCheckpointSec * SampleRate));
+    PromptBuffer.Empty();
+    return true;
+}
+
+void AMusicZone::RenormalizeOnsets()
+{
+    if (!bSongStarted || bSongFinished)
+        return;
+
+    //From here on the worker is stopped, so the analysis state, the checkpoints and the prompt queue belong to this thread
+    const double RenormalizeStart = FPlatformTime::Seconds();
+    bAnalyzing = false;
+    if (AnalysisFuture.IsValid())
+    {
+        AnalysisFuture.Wait();
+        AnalysisFuture = TFuture<void>();
+    }
+
+    const float SongScale = GetOnsetEnergyScale(LoudnessStats);
+    const float LeadScale = Checkpoints.Num() > 0 ? Checkpoints[0].OnsetEnergyScale : OnsetEnergyScale;
+    if (SongScale == LeadScale)
+    {
+        StartContinuousAnalysis();
+        return;
+    }
+
+    if (!RestartAnalysisWithGain(SongScale))
+    {
+        //An endless mix has released the start of the song by now, the song's gain can only take over from where the analysis is
+        OnsetEnergyScale = SongScale;
+        StartContinuousAnalysis();
+        return;
+    }
+
+    //Only up to a travel time past now is analyzed again on this thread, the worker does the rest. What is before now has been played
+    //with the lead's chart, from now on the chart is the one a cache hit would have made, so the notes that are due from now are spawned again
+    const double Now = GetSongTime();
+    const int64 End = FMath::Min<int64>((int64)(((Now + TravelTime) / TimeScale + 1.0) * SampleRate), DecodedFrames.load(std::memory_order_acquire));
+    const int32 HopIn = GetSourceSamplesPerHop();
+    {
+        TScopedScratch<float> HopScratch(ScratchPool.Get(), HopIn);
+        while (AnalysisCursorSamples + HopIn <= End)
+            AnalyzeHop(HopScratch.GetData(), HopIn);
+    }
+
+    TArray<FPrompt> Ahead;
+    FPrompt P;
+    while (PromptBuffer.Dequeue(P))
+    {
+        if (P.Time >= Now)
+            Ahead.Add(P);
+    }
+    for (const FPrompt& Kept : Ahead)
+        PromptBuffer.Enqueue(Kept);
+
+    for (int32 i = ActiveNotes.Num() - 1; i >= 0; --i)
+    {
+        if (ActiveNotes[i].ImpactTime < Now)
+            continue;
+        if (ActiveNotes[i].Actor.IsValid())
+            ActiveNotes[i].Actor->Destroy();
+        ActiveNotes.RemoveAtSwap(i);
+    }
+    while (Upcoming.Num() > 0 && Upcoming.Last().ImpactTime >= Now)
+        Upcoming.Pop(false);
+
+    StartContinuousAnalysis();
+
+    UE_LOG(LogTemp, Log, TEXT("[MZDBG] Onset gain %.2f from the lead replaced by %.2f from the whole song (%.1f LUFS) at %.2fs, analyzed %.2fs again in %.2f ms"),
+        LeadScale, SongScale, LoudnessStats.IntegratedLufs, Now, (double)AnalysisCursorSamples / SampleRate, (FPlatformTime::Seconds() - RenormalizeStart) * 1000.0);
+}
+
+void AMusicZone::FeedAnalysis(const float* Samples, int32 NumSamples)
+{
+    if (!bFiltersInited) { InitDrumFilters(); }
+
+    //Hop times come from the hop count at the analysis rate, each decimated sample covers exactly 1/EffectiveAnalysisRate seconds of the source
+    AnalysisDecimator.Process(Samples, NumSamples, AnalysisFifo);
+
+    int32 Consumed = 0;
+    while (AnalysisFifo.Num() - Consumed >= SamplesPerHop)
+    {
+        ProcessFrameForOnsets(AnalysisFifo.GetData() + Consumed, SamplesPerHop, AnalysisHopIndex * HopDuration);
+        Consumed += SamplesPerHop;
+        ++AnalysisHopIndex;
+    }
+    AnalysisFifo.RemoveAt(0, Consumed, false);
+}
+
 void AMusicZone::ProcessFrameForOnsets(const float* Frame, int32 NumSamples, double FrameStartTime)
 {
     if (!Frame || NumSamples <= 0) return;
-    if (!bFiltersInited) { InitDrumFilters(); }
 
     double sumKick = 0.0;
     double sumSnare = 0.0;
@@ -380,8 +1698,8 @@ void AMusicZone::ProcessFrameForOnsets(const float* Frame, int32 NumSamples, dou
         sumSnare += (double)ys * (double)ys;
     }
 
-    const float Ek = (float)(sumKick  / (double)NumSamples);
-    const float Es = (float)(sumSnare / (double)NumSamples);
+    const float Ek = (float)(sumKick  / (double)NumSamples) * OnsetEnergyScale;
+    const float Es = (float)(sumSnare / (double)NumSamples) * OnsetEnergyScale;
 
     const float FluxK = FMath::Max(0.0f, Ek - PrevKickEnergy);
     const float FluxS = FMath::Max(0.0f, Es - PrevSnareEnergy);
@@ -393,14 +1711,14 @@ void AMusicZone::ProcessFrameForOnsets(const float* Frame, int32 NumSamples, dou
     if (FluxK > KickThreshold && (FrameStartTime - LastKickTime) >= KickMinSpacing)
     {
         LastKickTime = FrameStartTime;
-        PromptBuffer.Enqueue({ FrameStartTime, FluxK });
+        PromptBuffer.Enqueue({ FrameStartTime * TimeScale, FluxK });
         bSpawned = true;
     }
 
     if (!bSpawned && FluxS > SnareThreshold && (FrameStartTime - LastSnareTime) >= SnareMinSpacing)
     {
         LastSnareTime = FrameStartTime;
-        PromptBuffer.Enqueue({ FrameStartTime, FluxS });
+        PromptBuffer.Enqueue({ FrameStartTime * TimeScale, FluxS });
     }
 }
 
@@ -473,16 +1791,46 @@ void AMusicZone::Tick(float DeltaSeconds)
 {
     Super::Tick(DeltaSeconds);
 
+    //The load runs on a worker thread, so its progress is only published from here to keep the delegate on the game thread
+    if (bLoading)
+    {
+        const float Progress = FMath::FloorToFloat(LoadProgress.load(std::memory_order_relaxed) * 100.0f) / 100.0f;
+        if (Progress != LastBroadcastProgress)
+        {
+            LastBroadcastProgress = Progress;
+            OnLoadProgress.Broadcast(Progress);
+        }
+    }
+
     if (!bSongStarted)
         return;
 
-    const double Now    = FPlatformTime::Seconds() - SongStartTime;
-    const double NowAdj = Now + SyncOffsetSec;
+    TickPlaylist();
+    if (bEndlessMix)
+        TickStreamWindow();
+
+    //Calibration measures against the raw clock, so its notes are drawn without any offset
+    const double Now    = GetSongTime();
+    const double NowAdj = Now + (bCalibrating ? 0.0 : SyncOffsetSec);
+
+    //The extra second lets the last notes reach the hit zone and be scored. A playlist song that is still being fetched holds the end back
+    if (Now >= GetPlayedDuration() + 1.0 && !bMoreTracksComing)
+    {
+        if (bCalibrating)
+            FinishCalibration();
+
+        bSongFinished = true;
+        bSongStarted  = false;
+        bAnalyzing    = false;
+        StopAndReset();
+        return;
+    }
 
     DrainAndSpawn(NowAdj);
     UpdateActiveNotes(NowAdj);
 
-    TickScoring(Now);
+    if (!bCalibrating)
+        TickScoring(Now - AudioOffsetSec);
 }
 
 void AMusicZone::StopAndReset()
@@ -490,10 +1838,26 @@ void AMusicZone::StopAndReset()
     const bool bAbandoned = (bSongStarted && !bSongFinished);
     const int32 Total = SuccessCount + FailCount;
     const float FinalPercent = (Total > 0) ? (100.0f * (float)SuccessCount / (float)Total) : 0.0f;
-    OnChallengeEnded.Broadcast(bAbandoned, FinalPercent);
+
+    //A calibration that ran to the end has reported already, one that was walked out of reports a failure
+    if (!bCalibrating)
+        OnChallengeEnded.Broadcast(bAbandoned, FinalPercent);
+    else if (bAbandoned)
+        OnCalibrationFinished.Broadcast(false, AudioOffsetSec, SyncOffsetSec);
+    bCalibrating = false;
     
     GetWorld()->GetTimerManager().ClearTimer(FileAskDelayHandle);
-    GetWorld()->GetTimerManager().ClearTimer(SongEndHandle);
+
+    //Leaving the zone while the song is still decoding cancels the load, nothing from it will reach StartSong
+    CancelLoad();
+    StopKeysoundClock();
+
+    //Stop the feed before anything else, a callback that is already converting a block finishes before FullPCM can be emptied below
+    {
+        FScopeLock Lock(&StreamLock);
+        bStreaming = false;
+        SongClock.Reset(0);
+    }
     
     if (AudioComp)
     {
@@ -502,6 +1866,9 @@ void AMusicZone::StopAndReset()
     }
     ProcWave = nullptr;
     
+    //The worker waits at the watermark while more audio is expected, which after a cancelled load or a dropped playlist never comes
+    bAnalyzing = false;
+    bMoreTracksComing = false;
     if (AnalysisFuture.IsValid())
     {
         AnalysisFuture.Wait();
@@ -516,11 +1883,32 @@ void AMusicZone::StopAndReset()
     
     ActiveNotes.Empty();
     FullPCM.Empty();
+    PlaybackPCM.Empty();
     PromptBuffer.Empty();
     
     AnalysisCursorSamples = 0;
+    AnalysisHopIndex = 0;
+    AnalysisFifo.Empty();
+    Checkpoints.Empty();
+    NextCheckpointSamples = 0;
+    TrackGains.Empty();
+    NextTrackGain = 0;
+    QueuedFrames.store(0, std::memory_order_relaxed);
+    StreamScratch.Return();
+    StretchScratch.Return();
+    Stretch.Init(0, 0, 1.0f);
+    WaveFrames = 0;
+    DecodedFrames.store(0, std::memory_order_relaxed);
+    bDecodeComplete = false;
+    PlaylistQueue.Reset();
+    bMoreTracksComing = false;
+    NextTrackStartFrame.store(-1, std::memory_order_relaxed);
+    AnalyzedFrames.store(0, std::memory_order_relaxed);
+    FullPCM.SetGrowLimit(0);
+    PlaybackPCM.SetGrowLimit(0);
     SongDuration  = 0.0;
     SongStartTime = 0.0;
+    SongClockBase = 0.0;
     bAnalyzing    = false;
     bSongStarted  = false;
     bSongFinished = true;
@@ -559,6 +1947,7 @@ void AMusicZone::TickScoring(double Now)
                 {
                     Front.Note->ApplyResult(false);
                 }
+                PlayKeysound(MissSound);
                 FailCount++;
                 const int32 Total = SuccessCount + FailCount;
                 const float Percent = (Total > 0) ? (100.0f * (float)SuccessCount / (float)Total) : 0.0f;
@@ -586,10 +1975,17 @@ void AMusicZone::OnHitKeyPressed()
     if (!bSongStarted)
         return;
 
-    const double Now = FPlatformTime::Seconds() - SongStartTime;
+    if (bCalibrating)
+    {
+        CalibrationTaps.Add(GetSongTime());
+        return;
+    }
+
+    const double Now = GetSongTime() - AudioOffsetSec;
 
     if (Upcoming.Num() == 0)
     {
+        PlayKeysound(MissSound);
         FailCount++;
         const int32 Total = SuccessCount + FailCount;
         const float Percent = (Total > 0) ? (100.0f * (float)SuccessCount / (float)Total) : 0.0f;
@@ -609,6 +2005,7 @@ void AMusicZone::OnHitKeyPressed()
             {
                 Front.Note->ApplyResult(true);
             }
+            PlayKeysound(HitSound);
             Front.bScored = true;
             SuccessCount++;
             const int32 Total = SuccessCount + FailCount;
@@ -621,6 +2018,7 @@ void AMusicZone::OnHitKeyPressed()
     }
     else
     {
+        PlayKeysound(MissSound);
         FailCount++;
         const int32 Total = SuccessCount + FailCount;
         const float Percent = (Total > 0) ? (100.0f * (float)SuccessCount / (float)Total) : 0.0f;
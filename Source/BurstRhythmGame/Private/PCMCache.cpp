@@ -0,0 +1,255 @@
+#include "PCMCache.h"
+#include "AudioKernels.h"
+
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Hash/xxhash.h"
+#include "Serialization/Archive.h"
+
+namespace
+{
+    constexpr uint32 CacheMagic   = 0x43505242; // "BRPC"
+    constexpr uint32 CacheVersion = 6;
+
+    //How much of the source HashSource hashes between two looks at the cancel flag
+    constexpr int64 HashBlockBytes = 16 * 1024 * 1024;
+
+    //The header is padded to 64 bytes so the samples behind it stay aligned inside the mapping. The loudness and the trimmed lead come along
+    //so a cache hit does not have to measure the song again. The int16 playback stream follows the analysis samples
+    struct FPCMCacheHeader
+    {
+        uint32 Magic      = CacheMagic;
+        uint32 Version    = CacheVersion;
+        uint32 SampleRate = 0;
+        uint32 Storage    = (uint32)EPCMStorage::Float32;
+        uint64 NumSamples = 0;
+        uint64 Key        = 0;
+        float  IntegratedLufs = 0.0f;
+        float  RmsDb      = 0.0f;
+        float  PeakDb     = 0.0f;
+        uint32 LeadingTrimFrames = 0;
+        uint32 PlaybackChannels = 0;
+        uint32 Reserved = 0;
+        uint64 NumPlaybackSamples = 0;
+    };
+    static_assert(sizeof(FPCMCacheHeader) == 64, "PCM cache header layout changed");
+
+    //A cache hit that plays straight from the mapping. The region has to be unmapped before its file handle closes, which the member order does
+    class FMappedCacheEntry : public FPCMTrackMapping
+    {
+    public:
+        TUniquePtr<IMappedFileHandle> File;
+        TUniquePtr<IMappedFileRegion> Region;
+    };
+}
+
+FString FPCMCache::GetCacheDir()
+{
+    return FPaths::ProjectSavedDir() / TEXT("PCMCache");
+}
+
+FString FPCMCache::GetEntryPath(uint64 Key)
+{
+    return GetCacheDir() / FString::Printf(TEXT("%016llx.brpcm"), Key);
+}
+
+uint64 FPCMCache::HashSource(const uint8* Data, int64 NumBytes, const FThreadSafeBool& bCancel)
+{
+    //Streaming the blocks through the builder gives the same hash as one HashBuffer over the whole file
+    FXxHash64Builder Builder;
+    for (int64 Offset = 0; Offset < NumBytes && !bCancel; Offset += HashBlockBytes)
+        Builder.Update(Data + Offset, (uint64)FMath::Min(HashBlockBytes, NumBytes - Offset));
+    return Builder.Finalize().Hash;
+}
+
+uint64 FPCMCache::MakeKey(uint64 SourceHash, const FPCMCacheSettings& Settings)
+{
+    //Fixed-size fields in a fixed order, so the key is the same on every run and platform
+    const uint8 Flags = (Settings.bTrimSilence ? 1 : 0) | (Settings.bDitherPlayback ? 2 : 0);
+    const float Threshold = Settings.bTrimSilence ? Settings.SilenceThresholdDb : 0.0f;
+
+    FXxHash64Builder Builder;
+    Builder.Update(&SourceHash, sizeof(SourceHash));
+    Builder.Update(&Flags, sizeof(Flags));
+    Builder.Update(&Threshold, sizeof(Threshold));
+    return Builder.Finalize().Hash;
+}
+
+bool FPCMCache::Load(uint64 Key, EPCMStorage Storage, FPCMTrack& OutTrack, FPCMTrack& OutPlayback, FPCMCacheMeta& OutMeta, const FThreadSafeBool& bCancel)
+{
+    const FString EntryPath = GetEntryPath(Key);
+
+    TUniquePtr<IMappedFileHandle> MappedFile(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*EntryPath));
+    if (!MappedFile || MappedFile->GetFileSize() < (int64)sizeof(FPCMCacheHeader))
+        return false;
+
+    TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile->MapRegion(0, MappedFile->GetFileSize(), /*bPreloadHint=*/true));
+    if (!MappedRegion)
+        return false;
+
+    FPCMCacheHeader Header;
+    FMemory::Memcpy(&Header, MappedRegion->GetMappedPtr(), sizeof(Header));
+
+    const EPCMStorage EntryStorage = (EPCMStorage)Header.Storage;
+    const int64 BytesPerSample = EntryStorage == EPCMStorage::Int16 ? sizeof(int16) : sizeof(float);
+    const int64 Expected = (int64)sizeof(FPCMCacheHeader) + (int64)Header.NumSamples * BytesPerSample + (int64)Header.NumPlaybackSamples * sizeof(int16);
+    if (Header.Magic != CacheMagic || Header.Version != CacheVersion || Header.Key != Key
+        || (EntryStorage != EPCMStorage::Float32 && EntryStorage != EPCMStorage::Int16)
+        || Header.SampleRate == 0 || Header.NumSamples == 0
+        || Header.PlaybackChannels == 0 || Header.NumPlaybackSamples != Header.NumSamples * Header.PlaybackChannels
+        || MappedRegion->GetMappedSize() != Expected)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("[MZDBG] Discarding stale PCM cache entry %s"), *EntryPath);
+        MappedRegion.Reset();
+        MappedFile.Reset();
+        IFileManager::Get().Delete(*EntryPath, false, false, true);
+        return false;
+    }
+
+    //The header keeps the samples aligned, so the mapping can be read as float or int16 directly
+    const uint8* Samples = MappedRegion->GetMappedPtr() + sizeof(FPCMCacheHeader);
+    const uint8* Playback = Samples + (int64)Header.NumSamples * BytesPerSample;
+    OutMeta.SampleRate = (int32)Header.SampleRate;
+    OutMeta.Loudness.IntegratedLufs = Header.IntegratedLufs;
+    OutMeta.Loudness.RmsDb  = Header.RmsDb;
+    OutMeta.Loudness.PeakDb = Header.PeakDb;
+    OutMeta.LeadingTrimFrames = Header.LeadingTrimFrames;
+    OutMeta.PlaybackChannels  = (int32)Header.PlaybackChannels;
+
+    //An entry in the storage the zone wants is played and analyzed straight from the mapping, the tracks keep it open for as long as they
+    //use it. The region was mapped with the preload hint, so the OS starts paging it in right away instead of on the render thread's first read.
+    //A track that will grow (a playlist appends to it) or needs the other storage gets its own chunks and a copy instead
+    if (EntryStorage == Storage && OutTrack.GetGrowLimit() == 0 && OutPlayback.GetGrowLimit() == 0)
+    {
+        TSharedPtr<FMappedCacheEntry, ESPMode::ThreadSafe> Entry = MakeShared<FMappedCacheEntry, ESPMode::ThreadSafe>();
+        Entry->File   = MoveTemp(MappedFile);
+        Entry->Region = MoveTemp(MappedRegion);
+        OutTrack.MapReadOnly(Storage, Samples, (int64)Header.NumSamples, Entry);
+        OutPlayback.MapReadOnly(EPCMStorage::Int16, Playback, (int64)Header.NumPlaybackSamples, Entry);
+        IFileManager::Get().SetTimeStamp(*EntryPath, FDateTime::UtcNow());
+        return true;
+    }
+
+    //Copied one track chunk at a time
+    OutTrack.Allocate(Storage, (int64)Header.NumSamples);
+    for (int32 Chunk = 0; Chunk < OutTrack.GetNumChunks() && !bCancel; ++Chunk)
+    {
+        const int64 First = (int64)Chunk * FPCMTrack::ChunkSamples;
+        const int32 Count = OutTrack.GetChunkNum(Chunk);
+        const uint8* Src  = Samples + First * BytesPerSample;
+
+        if (EntryStorage == Storage)
+            FMemory::Memcpy(OutTrack.GetChunkData(Chunk), Src, (SIZE_T)Count * BytesPerSample);
+        else if (EntryStorage == EPCMStorage::Float32)
+            OutTrack.Write(First, reinterpret_cast<const float*>(Src), Count);
+        else
+            AudioKernels::Int16ToFloat(reinterpret_cast<const int16*>(Src), reinterpret_cast<float*>(OutTrack.GetChunkData(Chunk)), Count);
+    }
+
+    OutPlayback.Allocate(EPCMStorage::Int16, (int64)Header.NumPlaybackSamples);
+    for (int32 Chunk = 0; Chunk < OutPlayback.GetNumChunks() && !bCancel; ++Chunk)
+    {
+        const int64 First = (int64)Chunk * FPCMTrack::ChunkSamples;
+        FMemory::Memcpy(OutPlayback.GetChunkData(Chunk), Playback + First * sizeof(int16), (SIZE_T)OutPlayback.GetChunkNum(Chunk) * sizeof(int16));
+    }
+
+    MappedRegion.Reset();
+    MappedFile.Reset();
+    if (bCancel)
+        return false;
+
+    //The modification time doubles as the last-used time for eviction
+    IFileManager::Get().SetTimeStamp(*EntryPath, FDateTime::UtcNow());
+    return true;
+}
+
+bool FPCMCache::Store(uint64 Key, const FPCMTrack& Track, const FPCMTrack& Playback, const FPCMCacheMeta& Meta, int64 MaxBytes, const FThreadSafeBool& bCancel)
+{
+    if (Track.Num() == 0 || Meta.SampleRate <= 0 || Meta.PlaybackChannels <= 0 || Playback.GetStorage() != EPCMStorage::Int16
+        || Playback.Num() != Track.Num() * Meta.PlaybackChannels)
+        return false;
+
+    const int64 PayloadBytes = Track.Num() * Track.GetBytesPerSample() + Playback.Num() * sizeof(int16);
+    const int64 EntryBytes = (int64)sizeof(FPCMCacheHeader) + PayloadBytes;
+    if (MaxBytes > 0 && EntryBytes > MaxBytes)
+        return false;
+
+    const FString EntryPath = GetEntryPath(Key);
+    const FString TempPath  = FString::Printf(TEXT("%s.%s.tmp"), *EntryPath, *FGuid::NewGuid().ToString());
+
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+    if (!Writer)
+        return false;
+
+    FPCMCacheHeader Header;
+    Header.SampleRate = (uint32)Meta.SampleRate;
+    Header.Storage    = (uint32)Track.GetStorage();
+    Header.NumSamples = (uint64)Track.Num();
+    Header.Key        = Key;
+    Header.IntegratedLufs = Meta.Loudness.IntegratedLufs;
+    Header.RmsDb      = Meta.Loudness.RmsDb;
+    Header.PeakDb     = Meta.Loudness.PeakDb;
+    Header.LeadingTrimFrames = (uint32)FMath::Clamp<int64>(Meta.LeadingTrimFrames, 0, MAX_uint32);
+    Header.PlaybackChannels  = (uint32)Meta.PlaybackChannels;
+    Header.NumPlaybackSamples = (uint64)Playback.Num();
+    Writer->Serialize(&Header, sizeof(Header));
+    //One chunk is 2-4 MB, so a cancel only waits for the chunk that is being written
+    for (int32 Chunk = 0; Chunk < Track.GetNumChunks() && !bCancel; ++Chunk)
+        Writer->Serialize(const_cast<uint8*>(Track.GetChunkData(Chunk)), (int64)Track.GetChunkNum(Chunk) * Track.GetBytesPerSample());
+    for (int32 Chunk = 0; Chunk < Playback.GetNumChunks() && !bCancel; ++Chunk)
+        Writer->Serialize(const_cast<uint8*>(Playback.GetChunkData(Chunk)), (int64)Playback.GetChunkNum(Chunk) * sizeof(int16));
+
+    const bool bWritten = Writer->Close() && !Writer->IsError() && !bCancel;
+    Writer.Reset();
+
+    if (!bWritten || !IFileManager::Get().Move(*EntryPath, *TempPath, true, true))
+    {
+        IFileManager::Get().Delete(*TempPath, false, false, true);
+        return false;
+    }
+
+    EvictToFit(MaxBytes, EntryPath);
+    return true;
+}
+
+void FPCMCache::EvictToFit(int64 MaxBytes, const FString& KeepPath)
+{
+    if (MaxBytes <= 0)
+        return;
+
+    struct FEntry
+    {
+        FString  Path;
+        int64    Size = 0;
+        FDateTime LastUsed;
+    };
+
+    const FString Dir = GetCacheDir();
+    TArray<FString> Files;
+    IFileManager::Get().FindFiles(Files, *(Dir / TEXT("*.brpcm")), true, false);
+
+    TArray<FEntry> Entries;
+    int64 TotalBytes = 0;
+    for (const FString& File : Files)
+    {
+        FEntry& E  = Entries.AddDefaulted_GetRef();
+        E.Path     = Dir / File;
+        E.Size     = FMath::Max<int64>(IFileManager::Get().FileSize(*E.Path), 0);
+        E.LastUsed = IFileManager::Get().GetTimeStamp(*E.Path);
+        TotalBytes += E.Size;
+    }
+
+    Entries.Sort([](const FEntry& A, const FEntry& B) { return A.LastUsed < B.LastUsed; });
+
+    for (const FEntry& E : Entries)
+    {
+        if (TotalBytes <= MaxBytes)
+            break;
+        if (E.Path == KeepPath)
+            continue;
+        if (IFileManager::Get().Delete(*E.Path, false, false, true))
+            TotalBytes -= E.Size;
+    }
+}
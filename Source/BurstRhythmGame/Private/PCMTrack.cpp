@@ -0,0 +1,190 @@
+#include "PCMTrack.h"
+
+#include "AudioKernels.h"
+#include "AudioScratchPool.h"
+
+FPCMTrack::~FPCMTrack()
+{
+    ReleaseChunks(0, Chunks.Num());
+}
+
+void FPCMTrack::Allocate(EPCMStorage InStorage, int64 InNumSamples)
+{
+    ReleaseChunks(0, Chunks.Num());
+
+    const int64 NewNum = FMath::Max<int64>(InNumSamples, 0);
+    Storage = InStorage;
+    MappedData = nullptr;
+    Mapping.Reset();
+    FirstResident.store(0, std::memory_order_relaxed);
+
+    //The slot table is created for the grow limit right away, so Extend only ever fills slots and never resizes the table under a reader
+    const int32 NumChunks = GetNumChunksFor(NewNum);
+    Chunks.Empty();
+    Chunks.SetNum(FMath::Max(NumChunks, GetNumChunksFor(GrowLimit)));
+    for (int32 c = 0; c < NumChunks; ++c)
+        Chunks[c] = AcquireChunk((GrowLimit > 0 ? (int32)ChunkSamples : (int32)FMath::Min<int64>(ChunkSamples, NewNum - (int64)c * ChunkSamples)) * GetBytesPerSample());
+    NumSamples.store(NewNum, std::memory_order_release);
+}
+
+void FPCMTrack::MapReadOnly(EPCMStorage InStorage, const uint8* Data, int64 InNumSamples, const TSharedPtr<FPCMTrackMapping, ESPMode::ThreadSafe>& InMapping)
+{
+    Empty();
+    Storage    = InStorage;
+    MappedData = Data;
+    Mapping    = InMapping;
+    NumSamples.store(FMath::Max<int64>(InNumSamples, 0), std::memory_order_release);
+}
+
+void FPCMTrack::Extend(int64 NewNum)
+{
+    //The slots exist up to the grow limit and the last chunk already has its full size, so only the empty slots behind it get memory.
+    //Readers never look past Num(), and the release store below is what makes the new chunks visible to them
+    check(!MappedData && CanGrowTo(NewNum));
+    const int64 OldNum = NumSamples.load(std::memory_order_relaxed);
+    if (NewNum <= OldNum)
+        return;
+
+    for (int32 c = GetNumChunksFor(OldNum); c < GetNumChunksFor(NewNum); ++c)
+        Chunks[c] = AcquireChunk((int32)ChunkSamples * GetBytesPerSample());
+    NumSamples.store(NewNum, std::memory_order_release);
+}
+
+void FPCMTrack::Truncate(int64 NewNum)
+{
+    //Readers may still hold pointers into the chunks below the new end, so only the chunks past it are released. The new end is published
+    //before that, so nobody starts reading a chunk that is about to go
+    const int64 OldNum = NumSamples.load(std::memory_order_relaxed);
+    NewNum = FMath::Clamp<int64>(NewNum, 0, OldNum);
+    NumSamples.store(NewNum, std::memory_order_release);
+    ReleaseChunks(GetNumChunksFor(NewNum), GetNumChunksFor(OldNum));
+}
+
+void FPCMTrack::Empty()
+{
+    NumSamples.store(0, std::memory_order_release);
+    FirstResident.store(0, std::memory_order_release);
+    ReleaseChunks(0, Chunks.Num());
+    Chunks.Empty();
+    MappedData = nullptr;
+    Mapping.Reset();
+}
+
+void FPCMTrack::ReleaseBefore(int64 Position)
+{
+    //The chunk Position lies in is still being read, everything before it goes back to the pool and its slot stays empty.
+    //The new start is published first, the caller guarantees that no reader is still below Position (see TickStreamWindow)
+    const int64 OldFirst = FirstResident.load(std::memory_order_relaxed);
+    const int32 EndChunk = (int32)(FMath::Clamp<int64>(Position, 0, NumSamples.load(std::memory_order_relaxed)) >> ChunkShift);
+    const int64 NewFirst = (int64)EndChunk << ChunkShift;
+    if (NewFirst <= OldFirst)
+        return;
+
+    FirstResident.store(NewFirst, std::memory_order_release);
+    ReleaseChunks((int32)(OldFirst >> ChunkShift), EndChunk);
+}
+
+void FPCMTrack::ReleaseChunks(int32 FirstChunk, int32 EndChunk)
+{
+    //Empties the slots but keeps them, only Allocate and Empty change how many there are
+    for (int32 c = FirstChunk; c < FMath::Min(EndChunk, Chunks.Num()); ++c)
+    {
+        if (Pool && Chunks[c].Num() > 0)
+            Pool->Release(MoveTemp(Chunks[c]));
+        Chunks[c].Empty();
+    }
+}
+
+TArray<uint8> FPCMTrack::AcquireChunk(int32 ChunkBytes) const
+{
+    if (Pool)
+        return Pool->Acquire(ChunkBytes);
+
+    TArray<uint8> Chunk;
+    Chunk.SetNumUninitialized(ChunkBytes);
+    return Chunk;
+}
+
+SIZE_T FPCMTrack::GetAllocatedSize() const
+{
+    SIZE_T Size = Chunks.GetAllocatedSize();
+    for (const TArray<uint8>& Chunk : Chunks)
+        Size += Chunk.GetAllocatedSize();
+    return Size;
+}
+
+void FPCMTrack::Write(int64 Offset, const float* Src, int32 Count, AudioKernels::FTPDFDither* Dither)
+{
+    check(!MappedData && Offset >= GetFirstResident() && Count >= 0 && Offset + Count <= Num());
+
+    while (Count > 0)
+    {
+        const int32 Run = FMath::Min(Count, ContiguousFrom(Offset));
+        if (Storage == EPCMStorage::Float32)
+            FMemory::Memcpy(SamplePtr<float>(Offset), Src, (SIZE_T)Run * sizeof(float));
+        else
+            AudioKernels::FloatToInt16(Src, SamplePtr<int16>(Offset), Run, Dither);
+
+        Offset += Run;
+        Src    += Run;
+        Count  -= Run;
+    }
+}
+
+void FPCMTrack::Write(int64 Offset, const int16* Src, int32 Count)
+{
+    check(!MappedData && Offset >= GetFirstResident() && Count >= 0 && Offset + Count <= Num());
+
+    while (Count > 0)
+    {
+        const int32 Run = FMath::Min(Count, ContiguousFrom(Offset));
+        if (Storage == EPCMStorage::Int16)
+            FMemory::Memcpy(SamplePtr<int16>(Offset), Src, (SIZE_T)Run * sizeof(int16));
+        else
+            AudioKernels::Int16ToFloat(Src, SamplePtr<float>(Offset), Run);
+
+        Offset += Run;
+        Src    += Run;
+        Count  -= Run;
+    }
+}
+
+const float* FPCMTrack::ReadFloat(int64 Offset, int32 Count, float* Scratch) const
+{
+    check(Offset >= GetFirstResident() && Count >= 0 && Offset + Count <= Num());
+
+    if (Storage == EPCMStorage::Float32 && Count <= ContiguousFrom(Offset))
+        return SamplePtr<float>(Offset);
+
+    for (int32 Done = 0; Done < Count; )
+    {
+        const int64 Position = Offset + Done;
+        const int32 Run = FMath::Min(Count - Done, ContiguousFrom(Position));
+        if (Storage == EPCMStorage::Float32)
+            FMemory::Memcpy(Scratch + Done, SamplePtr<float>(Position), (SIZE_T)Run * sizeof(float));
+        else
+            AudioKernels::Int16ToFloat(SamplePtr<int16>(Position), Scratch + Done, Run);
+        Done += Run;
+    }
+    return Scratch;
+}
+
+const int16* FPCMTrack::ReadInt16(int64 Offset, int32 Count, int16* Scratch, AudioKernels::FTPDFDither* Dither) const
+{
+    check(Offset >= GetFirstResident() && Count >= 0 && Offset + Count <= Num());
+
+    if (Storage == EPCMStorage::Int16 && Count <= ContiguousFrom(Offset))
+        return SamplePtr<int16>(Offset);
+
+    for (int32 Done = 0; Done < Count; )
+    {
+        const int64 Position = Offset + Done;
+        const int32 Run = FMath::Min(Count - Done, ContiguousFrom(Position));
+        if (Storage == EPCMStorage::Int16)
+            FMemory::Memcpy(Scratch + Done, SamplePtr<int16>(Position), (SIZE_T)Run * sizeof(int16));
+        else
+            AudioKernels::FloatToInt16(SamplePtr<float>(Position), Scratch + Done, Run, Dither);
+        Done += Run;
+    }
+    return Scratch;
+}
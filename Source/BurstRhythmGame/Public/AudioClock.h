@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+//Song position taken from the samples the audio render thread has actually pulled out of the stream. The render thread only reports
+//when it refills the procedural wave, so between reports the clock runs on FPlatformTime at a rate that a small PI loop keeps locked onto
+//the reports. That takes device start latency and buffering out of song time and follows the audio device's clock when it drifts from
+//the CPU's. There is a single writer (Observe), GetSeconds can be called from any thread and never blocks, the filter output is
+//published through a sequence counter
+class BURSTRHYTHMGAME_API FAudioClock
+{
+public:
+    //Only called while nothing observes, i.e. before the stream starts or after it stopped
+    void Reset(int32 InSampleRate);
+
+    //PlayedFrames of the stream have been handed to the mixer as of PlatformSeconds
+    void Observe(int64 PlayedFrames, double PlatformSeconds);
+
+    //Song time in seconds at PlatformSeconds, 0 until the first report
+    double GetSeconds(double PlatformSeconds) const;
+
+    bool HasStarted() const { return Sequence.load(std::memory_order_acquire) != 0; }
+
+    //Audio clock speed relative to FPlatformTime as the filter currently sees it
+    double GetRate() const;
+
+private:
+    void Publish();
+
+    //Writer side, only touched by Reset and Observe
+    int32  SampleRate     = 0;
+    bool   bAnchored      = false;
+    double AnchorPlatform = 0.0;
+    double AnchorSong     = 0.0;
+    double Rate           = 1.0;
+
+    //Reader side. Sequence is odd while a publish is in progress and 0 until the first one
+    std::atomic<uint32> Sequence { 0 };
+    std::atomic<double> PublishedPlatform { 0.0 };
+    std::atomic<double> PublishedSong { 0.0 };
+    std::atomic<double> PublishedRate { 1.0 };
+};
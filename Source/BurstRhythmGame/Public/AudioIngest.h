@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/MappedFileHandle.h"
+
+class FAudioScratchPool;
+
+//Container formats the decoders understand, told apart by their header bytes rather than the file name
+enum class EAudioContainer : uint8
+{
+    Unknown,
+    Wav,
+    Mp3,
+};
+
+//The bytes of one source file, read exactly once. Files are mapped when the platform allows it and read into memory otherwise (pak files
+//for example), bytes that did not come from a loose file at all can be handed over with Assign. Every decoder, the cache hash and the
+//parallel MP3 shards work on the same buffer, which stays valid until Reset or destruction. A file that has to be read goes into a buffer
+//borrowed from Pool when one is given, and the buffer goes back there on Reset
+class BURSTRHYTHMGAME_API FAudioIngest
+{
+public:
+    FAudioIngest() = default;
+    FAudioIngest(const FAudioIngest&) = delete;
+    FAudioIngest& operator=(const FAudioIngest&) = delete;
+    ~FAudioIngest() { Reset(); }
+
+    bool Open(const FString& FilePath, bool bAllowMap, FAudioScratchPool* InPool = nullptr);
+    void Assign(TArray<uint8>&& InBytes);
+    void Reset();
+
+    const uint8* GetData() const { return Data; }
+    int64 Num() const { return NumBytes; }
+    bool IsMapped() const { return MappedRegion.IsValid(); }
+    EAudioContainer GetContainer() const { return Container; }
+
+    //RIFF/RF64/BW64 and Sony Wave64 headers are WAV, anything minimp3 finds a valid frame sequence in (after an optional ID3v2 tag) is MP3
+    static EAudioContainer Probe(const uint8* InData, int64 InNumBytes);
+
+private:
+    TUniquePtr<IMappedFileHandle> MappedFile;
+    TUniquePtr<IMappedFileRegion> MappedRegion;
+    TArray<uint8> OwnedBytes;
+    FAudioScratchPool* Pool = nullptr;
+    const uint8* Data = nullptr;
+    int64 NumBytes = 0;
+    EAudioContainer Container = EAudioContainer::Unknown;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Small, allocation-free sample kernels shared by the decoders. Every function works on caller-owned buffers so they can be run
+//on a single decode block at a time from any thread. The AVX2 loops are compiled into every x64 build and picked at run time when
+//FPlatformMisc::HasAVX2InstructionSupport says so, otherwise SSE2 does the work
+namespace AudioKernels
+{
+    //Averages the channels of an interleaved block into one mono sample per frame. Stereo, 5.1 and 7.1 have SSE2 fast paths on x86 and
+    //stereo also an AVX2 one, any other channel count goes through the generic loop. Out must hold NumFrames floats and may not alias In
+    BURSTRHYTHMGAME_API void DownmixToMono(const float* In, float* Out, int32 NumFrames, int32 NumChannels);
+
+    //Folds an interleaved block with more than two channels down to interleaved stereo for playback. 5.1 and 7.1 use the ITU-R BS.775
+    //coefficients (centre and surrounds at -3 dB, LFE dropped) normalized so a full-scale input cannot clip, any other layout sends even
+    //channels left and odd channels right. Out must hold 2 * NumFrames floats and may not alias In
+    BURSTRHYTHMGAME_API void DownmixToStereo(const float* In, float* Out, int32 NumFrames, int32 NumChannels);
+
+    //Converts int16 samples to float, multiplying each by Scale (1/32768 maps the full int16 range onto [-1, 1))
+    BURSTRHYTHMGAME_API void Int16ToFloat(const int16* In, float* Out, int32 NumSamples, float Scale = 1.0f / 32768.0f);
+
+    //Noise source for FloatToInt16's dither, four xorshift32 generators run side by side. Keep one per stream so consecutive blocks
+    //continue the same sequence instead of repeating it
+    struct FTPDFDither
+    {
+        uint32 State[4] = { 0x9E3779B9u, 0x7F4A7C15u, 0x85EBCA6Bu, 0xC2B2AE35u };
+
+        void Seed(uint32 InSeed)
+        {
+            for (int32 Lane = 0; Lane < 4; ++Lane)
+                State[Lane] = (InSeed + 0x9E3779B9u * (uint32)(Lane + 1)) | 1u;
+        }
+    };
+
+    //Scales float samples by 32768, rounds half up and saturates to int16. Without dither the result is bit-exact with
+    //Clamp(RoundToInt(x * 32768), -32768, 32767) for every input that loop handled without overflowing, NaN becomes -32768 in both.
+    //With Dither, triangular noise of +-1 LSB is added before rounding, which turns the rounding error of quiet passages into
+    //steady hiss instead of distortion that follows the signal. SSE2 on x86, AVX2 for the undithered path when the CPU has it.
+    //
+    //The scale is 32768 on purpose, the playback conversion before this kernel used Clamp(x, -1, 1) * 32767. 32768 is the exact inverse of
+    //Int16ToFloat and of dr_wav's s16 to f32 conversion (both divide by 32768), so the samples of 16-bit WAVs and of MP3s, which minimp3 decodes
+    //to int16, come back bit-exact after a trip through float storage. With 32767 every sample above half scale came back one LSB towards zero.
+    //Against the old loop the output differs by at most 1 LSB for any input, and full scale now saturates: +1.0 gives 32767, -1.0 gives -32768
+    BURSTRHYTHMGAME_API void FloatToInt16(const float* In, int16* Out, int32 NumSamples, FTPDFDither* Dither = nullptr);
+
+    //Sum of A[i] * B[i]. Accumulates in several float lanes, so the result can differ from a sequential sum in the last bits
+    BURSTRHYTHMGAME_API float DotProduct(const float* A, const float* B, int32 NumSamples);
+
+    //Out[i] = A[i] * B[i] + Add[i], or just the product when Add is null. Out may alias A or Add
+    BURSTRHYTHMGAME_API void MultiplyAdd(const float* A, const float* B, const float* Add, float* Out, int32 NumSamples);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AudioScratchPool.generated.h"
+
+//Thread-safe free list of byte buffers. Decoders, the PCM track chunks and the procedural wave feed borrow their buffers here and give them
+//back when a session ends, so hopping between zones reuses the same allocations instead of freeing and reallocating hundreds of MB.
+//Buffers that would push the pooled total over the cap are freed instead of pooled
+class BURSTRHYTHMGAME_API FAudioScratchPool
+{
+public:
+    struct FStats
+    {
+        int64 Requests       = 0;
+        int64 Hits           = 0;
+        int64 PooledBytes    = 0;
+        int64 HighWaterBytes = 0;
+        int64 DroppedBytes   = 0;
+
+        float GetHitRate() const { return Requests > 0 ? (float)Hits / (float)Requests : 0.0f; }
+    };
+
+    explicit FAudioScratchPool(int64 InMaxPooledBytes) : MaxPooledBytes(InMaxPooledBytes) {}
+
+    //Hands out a buffer of exactly NumBytes (uninitialized). A pooled buffer is reused if its capacity is at least NumBytes and not
+    //more than twice that, so a small request never pins a chunk-sized buffer
+    TArray<uint8> Acquire(int64 NumBytes);
+    void Release(TArray<uint8>&& Buffer);
+
+    void Trim();
+    FStats GetStats() const;
+
+private:
+    mutable FCriticalSection Lock;
+    TArray<TArray<uint8>> Free;
+    int64 MaxPooledBytes = 0;
+    FStats Stats;
+};
+
+//Borrows a buffer of Num elements of T from a pool for the lifetime of the scope. Without a pool it is a plain allocation.
+//As a member it borrows and returns explicitly, whatever it still holds goes back when it is destroyed
+template <typename T>
+class TScopedScratch
+{
+public:
+    TScopedScratch() = default;
+
+    TScopedScratch(FAudioScratchPool* InPool, int32 Num)
+    {
+        Borrow(InPool, Num);
+    }
+
+    ~TScopedScratch()
+    {
+        Return();
+    }
+
+    TScopedScratch(const TScopedScratch&) = delete;
+    TScopedScratch& operator=(const TScopedScratch&) = delete;
+
+    void Borrow(FAudioScratchPool* InPool, int32 Num)
+    {
+        Return();
+        Pool = InPool;
+        const int64 NumBytes = (int64)Num * sizeof(T);
+        if (Pool)
+            Bytes = Pool->Acquire(NumBytes);
+        else
+            Bytes.SetNumUninitialized((int32)NumBytes);
+    }
+
+    void Return()
+    {
+        if (Pool)
+            Pool->Release(MoveTemp(Bytes));
+        Pool = nullptr;
+        Bytes.Empty();
+    }
+
+    T* GetData() { return reinterpret_cast<T*>(Bytes.GetData()); }
+    int32 Num() const { return Bytes.Num() / (int32)sizeof(T); }
+
+private:
+    FAudioScratchPool* Pool = nullptr;
+    TArray<uint8> Bytes;
+};
+
+//Owns the scratch pool of one world. Zones grab the pool on BeginPlay, tracks and in-flight loads keep it alive through the shared pointer
+//even if the world goes away first
+UCLASS()
+class BURSTRHYTHMGAME_API UAudioScratchSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+
+    const TSharedPtr<FAudioScratchPool, ESPMode::ThreadSafe>& GetPool() const { return Pool; }
+
+private:
+    TSharedPtr<FAudioScratchPool, ESPMode::ThreadSafe> Pool;
+};
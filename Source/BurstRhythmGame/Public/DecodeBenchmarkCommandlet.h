@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DecodeBenchmarkCommandlet.generated.h"
+
+class AMusicZone;
+class FAudioIngest;
+enum class EAudioContainer : uint8;
+
+//Runs the music zone's WAV/MP3 decoders over every audio file in a directory and writes the timings as JSON, so decode performance can be
+//tracked without going through the file dialog. Example:
+//  UnrealEditor-Cmd BurstRhythmGame.uproject -run=DecodeBenchmark -Dir=D:/Songs [-Out=path.json] [-Runs=3] [-Compact] [-Serial] [-PlaylistCheck[=4]] -nullrhi
+//-Compact decodes into int16 storage, -Serial turns the parallel MP3 decode off. Without -Serial every MP3 is also decoded serially and
+//the two results are compared bitwise, the JSON then holds the first mismatching sample of each stream and the speedup. Every song is also
+//charted twice, once with the whole song's onset gain and once the way a progressive start does it, and firstChartMismatch is -1 when the
+//two charts are identical. -PlaylistCheck plays the shortest song followed by a queue of the shortest and the longest through the playlist
+//fetch, at the given multiple of real time, and reports how many seconds of playback ran dry waiting for a song. The PCM cache is never used
+//and silence is never trimmed, so the real-time factor is over the whole file. residentMB is the file's own streams, the processPeakRss
+//fields are the whole process's peak and how much the file raised it
+UCLASS()
+class BURSTRHYTHMGAME_API UDecodeBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UDecodeBenchmarkCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+
+private:
+    //Members rather than free functions so the zone's friend declaration lets them at its decoders and streams
+    static bool TimedDecode(AMusicZone* Zone, const FAudioIngest& Source, EAudioContainer Container, double& OutSeconds);
+    static int32 CompareProgressiveChart(AMusicZone* Zone, float& OutLeadGain, float& OutSongGain, int32& OutNumPrompts);
+    static bool CheckPlaylistPrefetch(AMusicZone* Zone, const FString& ShortFile, const FString& LongFile, float Speedup, double& OutGapSeconds);
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Level statistics of a whole decoded track
+struct FLoudnessStats
+{
+    //Gated integrated loudness in LUFS, -inf dB for silence
+    float IntegratedLufs = -INFINITY;
+    float RmsDb  = -INFINITY;
+    float PeakDb = -INFINITY;
+
+    bool IsValid() const { return FMath::IsFinite(IntegratedLufs); }
+};
+
+//Streaming integrated loudness after ITU-R BS.1770: K-weighting, 400 ms blocks every 100 ms, an absolute gate at -70 LUFS and a relative
+//gate 10 LU below the ungated mean. It is fed the mono downmix block by block as the decoder produces it, so it never needs a pass of its own.
+//Measuring the downmix instead of summing the channels reads decorrelated stereo up to 3 dB low, which is fine for normalizing the onset
+//detector since every song is measured the same way. The blocks go into a fixed histogram of 0.1 LU bins from -70 to +5 LUFS that keeps
+//a count and the summed power of each bin, so the meter stays at 12 KB however long it runs and an endless mix never grows it
+class BURSTRHYTHMGAME_API FLoudnessMeter
+{
+public:
+    void Init(int32 InSampleRate);
+    void Process(const float* Samples, int32 NumSamples);
+
+    //Parallel decodes run one meter per shard and merge them in the end. The blocks that straddle a shard edge are lost, which moves
+    //the result by far less than the gating does
+    void Merge(const FLoudnessMeter& Other);
+
+    FLoudnessStats GetStats() const;
+
+private:
+    struct FKWeight
+    {
+        double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+        double z1 = 0, z2 = 0;
+
+        FORCEINLINE double Process(double x)
+        {
+            const double y = b0 * x + z1;
+            z1 = b1 * x + z2 - a1 * y;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    FKWeight Shelf, HighPass;
+
+    int32  SubBlockLength = 0;
+    int32  SubBlockFill   = 0;
+    double SubBlockSum    = 0.0;
+    double RecentSubBlocks[4] = {};
+    int32  NumSubBlocks   = 0;
+
+    //Blocks by loudness. Everything at or below -70 LUFS fails the absolute gate and is never binned, louder than +5 goes in the top bin.
+    //The power sums are exact, only the relative gate is decided per bin, which moves the result by less than the bin width
+    static constexpr int32 NumBins = 750;
+    static constexpr double BinsPerLu = 10.0;
+    static constexpr double LowestLufs = -70.0;
+    int64  BinCounts[NumBins] = {};
+    double BinPowers[NumBins] = {};
+
+    double SumSquares = 0.0;
+    float  Peak = 0.0f;
+    int64  NumMeasured = 0;
+};
@@ -23,6 +23,12 @@ public:
 	UFUNCTION(BlueprintImplementableEvent, Category="Rhythm|HUD")
 	void BP_OnChallengeEnded(bool bAbandoned, float FinalPercent);
 
+	UFUNCTION(BlueprintImplementableEvent, Category="Rhythm|HUD")
+	void BP_OnLoadProgress(float Progress);
+
+	UFUNCTION(BlueprintImplementableEvent, Category="Rhythm|HUD")
+	void BP_OnCalibrationFinished(bool bSuccess, float AudioOffsetSec, float SyncOffsetSec);
+
 	UFUNCTION(BlueprintImplementableEvent, Category="Rhythm|HUD")
 	void BP_OnZoneBound(AMusicZone* Zone);
 
@@ -38,5 +44,11 @@ private:
 	UFUNCTION()
 	void HandleChallengeEnded(bool bAbandoned, float FinalPercent);
 
+	UFUNCTION()
+	void HandleLoadProgress(float Progress);
+
+	UFUNCTION()
+	void HandleCalibrationFinished(bool bSuccess, float AudioOffsetSec, float SyncOffsetSec);
+
 	void UnbindDelegates();
 };
\ No newline at end of file
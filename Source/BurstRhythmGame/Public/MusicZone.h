@@ -4,11 +4,22 @@
 #include "Async/Future.h"
 #include "GameFramework/Actor.h"
 #include "Components/BoxComponent.h"
+#include "AudioClock.h"
+#include "AudioScratchPool.h"
+#include "AudioKernels.h"
+#include "LoudnessMeter.h"
+#include "PCMTrack.h"
+#include "TimeStretch.h"
+#include "Tasks/Task.h"
+#include <atomic>
 #include "MusicZone.generated.h"
 
 class ANoteActor;
+class FAudioIngest;
 class USoundWaveProcedural;
+class USoundBase;
 class UAudioComponent;
+class UQuartzClockHandle;
 
 USTRUCT()
 struct FPrompt
@@ -39,12 +50,25 @@ struct FHitWindow
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnBeatScored, bool, bSuccess, int32, SuccessCount, int32, FailCount, float, Percent);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnChallengeEnded, bool, bAbandoned, float, FinalPercent);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnLoadProgress, float, Progress);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnCalibrationFinished, bool, bSuccess, float, AudioOffsetSec, float, SyncOffsetSec);
+
+UENUM(BlueprintType)
+enum class EZoneSessionType : uint8
+{
+    Song,
+    //Plays a click track and measures this machine's audio and visual latency instead of asking for a song
+    Calibration
+};
 
 UCLASS()
 class BURSTRHYTHMGAME_API AMusicZone : public AActor
 {
     GENERATED_BODY()
 
+    //The decode benchmark drives the decoders directly, without the file dialog, the cache or the song start
+    friend class UDecodeBenchmarkCommandlet;
+
 public:
     AMusicZone();
 
@@ -53,6 +77,7 @@ public:
     virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
     TFuture<void> AnalysisFuture;
+    TFuture<void> LoadFuture;
 
     UPROPERTY(EditAnywhere, Category="Rhythm|Detect|Drums") float KickCenterHz   = 90.0f;
     UPROPERTY(EditAnywhere, Category="Rhythm|Detect|Drums") float KickQ          = 1.4f;
@@ -90,6 +115,23 @@ public:
             z1 = z2 = 0.0f;
         }
 
+        //RBJ low-pass, the sections of a Butterworth cascade get their Q from FDecimator::Init
+        void SetLowPass(float sampleRate, float cutoffHz, float Q)
+        {
+            const float w0   = 2.0f * PI * cutoffHz / sampleRate;
+            const float cosw = FMath::Cos(w0);
+            const float sinw = FMath::Sin(w0);
+            const float alpha = sinw / (2.0f * Q);
+
+            const float a0n = 1.0f + alpha;
+            a0 = 0.5f * (1.0f - cosw) / a0n;
+            a1 = (1.0f - cosw) / a0n;
+            a2 = a0;
+            b1 = -2.0f * cosw / a0n;
+            b2 = (1.0f - alpha) / a0n;
+            z1 = z2 = 0.0f;
+        }
+
         FORCEINLINE float Process(float x)
         {
             const float y = a0*x + z1;
@@ -99,7 +141,66 @@ public:
         }
     };
 
+    //Decimator in front of the drum filters. The input first goes through an 8th order Butterworth low-pass at 0.45 of the output rate,
+    //then every output sample is the mean of the filtered input over exactly Ratio input samples, with the samples straddling a window edge
+    //split between the two windows, so the output runs at a fixed rate for any source rate. The box average alone is not an anti-alias
+    //filter, its first sidelobe is only 13 dB down, so hi-hats and cymbals above the output Nyquist would fold into the snare band.
+    //With the cascade in front, content that could alias into the drum bands (below 3.5 kHz at 11025) is down by more than 35 dB.
+    //All filter state lives in here, so an analysis checkpoint that copies the decimator resumes it exactly
+    struct FDecimator
+    {
+        static constexpr int32 NumSections = 4;
+
+        double Ratio = 1.0;
+        double Fill  = 0.0;
+        double Acc   = 0.0;
+        FBiquad AntiAlias[NumSections];
+
+        void Init(double InRate, double OutRate)
+        {
+            Ratio = FMath::Max(1.0, InRate / OutRate);
+            Fill = Acc = 0.0;
+
+            //Section k of a Butterworth low-pass of order 2N has Q = 1 / (2 cos((2k - 1) pi / 4N))
+            for (int32 k = 0; k < NumSections; ++k)
+                AntiAlias[k].SetLowPass((float)InRate, (float)(0.45 * OutRate), 1.0f / (2.0f * FMath::Cos((2 * k + 1) * PI / (4 * NumSections))));
+        }
+
+        void Process(const float* In, int32 NumIn, TArray<float>& Out)
+        {
+            if (Ratio == 1.0)
+            {
+                Out.Append(In, NumIn);
+                return;
+            }
+
+            const double InvRatio = 1.0 / Ratio;
+            for (int32 i = 0; i < NumIn; ++i)
+            {
+                float Filtered = In[i];
+                for (FBiquad& Section : AntiAlias)
+                    Filtered = Section.Process(Filtered);
+
+                const double x = Filtered;
+                const double Room = Ratio - Fill;
+                if (Room > 1.0)
+                {
+                    Acc  += x;
+                    Fill += 1.0;
+                    continue;
+                }
+
+                //Ratio is at least 1, so the leftover part of a sample can never close the next window too
+                Out.Add((float)((Acc + x * Room) * InvRatio));
+                Fill = 1.0 - Room;
+                Acc  = x * Fill;
+            }
+        }
+    };
+
     FBiquad KickBP, SnareBP;
+    FDecimator AnalysisDecimator;
+    float OnsetEnergyScale = 1.0f;
     bool bFiltersInited = false;
 
     float  PrevKickEnergy  = 0.0f;
@@ -108,6 +209,22 @@ public:
     double LastSnareTime   = -1000.0;
 
     void InitDrumFilters();
+    float GetOnsetEnergyScale(const FLoudnessStats& Stats) const;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Detect", meta=(ClampMin="4000", ToolTip="Rate the onset detector runs at. Songs are low-passed and averaged down to it first, so analysis cost and timing do not depend on the file's sample rate."))
+    int32 AnalysisSampleRate = 11025;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Detect", meta=(ClampMin="5", ClampMax="200", ToolTip="Length of one onset detection hop in milliseconds."))
+    float AnalysisHopMs = 46.4f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Detect", meta=(ToolTip="Scale the onset detector input so every song hits it at OnsetReferenceLufs. Keeps the note density of quiet and loud masters comparable with the same thresholds."))
+    bool bNormalizeOnsetLoudness = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Detect", meta=(EditCondition="bNormalizeOnsetLoudness", ToolTip="Integrated loudness the drum thresholds are tuned for."))
+    float OnsetReferenceLufs = -14.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Detect", meta=(ClampMin="0", EditCondition="bNormalizeOnsetLoudness", ToolTip="Largest boost or cut the normalization applies, in dB. Keeps near-silent tracks from being blown up into noise."))
+    float MaxOnsetGainDb = 20.0f;
 
     UPROPERTY(EditAnywhere, Category="Rhythm|Scoring")
     FKey HitKey = EKeys::E;
@@ -115,6 +232,15 @@ public:
     UPROPERTY(EditAnywhere, Category="Rhythm|Scoring")
     float ScoreHalfWindowSec = 0.25f;
 
+    UPROPERTY(EditAnywhere, Category="Rhythm|Keysounds", meta=(ToolTip="Played when a press lands on a note. Loaded with the zone, a sound wave set to Force Inline also skips the first-play decompression."))
+    USoundBase* HitSound = nullptr;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Keysounds", meta=(ToolTip="Played for a press that hits nothing and for a note that passes unhit."))
+    USoundBase* MissSound = nullptr;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Keysounds", meta=(ClampMin="1", ClampMax="32", ToolTip="Audio components created up front for keysounds. When all are busy the one that started first is reused."))
+    int32 KeysoundVoices = 8;
+
     UPROPERTY(BlueprintReadOnly, Category="Rhythm|Scoring")
     int32 SuccessCount = 0;
 
@@ -126,6 +252,18 @@ public:
 
     UPROPERTY(BlueprintAssignable, Category="Rhythm|Events")
     FOnChallengeEnded OnChallengeEnded;
+
+    UPROPERTY(BlueprintAssignable, Category="Rhythm|Events")
+    FOnLoadProgress OnLoadProgress;
+
+    UPROPERTY(BlueprintAssignable, Category="Rhythm|Events")
+    FOnCalibrationFinished OnCalibrationFinished;
+
+    //Jumps the running song to SongSeconds on the song timeline (trimmed source time, before the practice stretch). Fails while nothing is
+    //playing, during calibration, past what is decoded, more than one checkpoint interval past what the analysis has reached, and in an
+    //endless mix for audio that was already released
+    UFUNCTION(BlueprintCallable, Category="Rhythm|Practice")
+    bool SeekToTime(float SongSeconds);
     
 private:
     UPROPERTY(VisibleAnywhere, Category="Zone")
@@ -146,53 +284,298 @@ private:
     UPROPERTY(EditAnywhere, Category="Rhythm|Visual")
     float TravelTime = 5.0f;
 
-    UPROPERTY(EditAnywhere, Category="Rhythm|Sync")
+    UPROPERTY(EditAnywhere, Category="Rhythm|Sync", meta=(ToolTip="How far notes are drawn ahead of the song clock, so they reach the hit zone when the player hears the beat."))
     float SyncOffsetSec = 0.08f;
 
-    TArray<float> FullPCM;
+    UPROPERTY(EditAnywhere, Category="Rhythm|Sync", meta=(ToolTip="Time from the song clock to the player hearing a beat and pressing HitKey. Presses are moved back by this much before they are scored."))
+    float AudioOffsetSec = 0.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Sync", meta=(ToolTip="Use the offsets a calibration zone saved on this machine instead of the two above."))
+    bool bUseSavedSync = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Sync", meta=(ToolTip="Song zones play a song picked by the player, calibration zones play a click track and measure the sync offsets."))
+    EZoneSessionType SessionType = EZoneSessionType::Song;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Sync", meta=(ClampMin="40", ClampMax="200", EditCondition="SessionType==EZoneSessionType::Calibration", ToolTip="Tempo of the calibration click track."))
+    float CalibrationBpm = 100.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Sync", meta=(ClampMin="4", ClampMax="64", EditCondition="SessionType==EZoneSessionType::Calibration", ToolTip="Beats in each calibration phase. The player taps along to clicks they only hear, then to notes they only see."))
+    int32 CalibrationBeats = 16;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Map song files instead of loading them into memory. Falls back to a regular read if the file cannot be mapped."))
+    bool bMemoryMapSource = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Start playback and analysis once ProgressiveLeadSec of audio is decoded, the rest keeps decoding behind it."))
+    bool bProgressiveStart = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ClampMin="1", EditCondition="bProgressiveStart", ToolTip="Seconds of decoded audio needed before a progressive load starts the song."))
+    float ProgressiveLeadSec = 10.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Split long MP3s into frame-aligned ranges and decode them on the task graph workers. Not used for progressive loads, which need the track decoded in order."))
+    bool bParallelMp3Decode = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ClampMin="0", ToolTip="MP3s shorter than this many seconds are always decoded serially."))
+    float ParallelMp3MinSeconds = 60.0f;
+
+    static constexpr int32 MaxMp3DecodeShards = 16;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Keep decoded songs under Saved/PCMCache so re-entering a zone skips the decode."))
+    bool bUsePCMCache = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ClampMin="0", EditCondition="bUsePCMCache", ToolTip="Size cap of the PCM cache in MB, least recently used songs are evicted first. 0 disables the cap."))
+    int32 PCMCacheMaxMB = 2048;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Keep the decoded song as int16 instead of float. Halves resident audio memory, analysis converts one hop at a time. See FPCMTrack for the accuracy tolerance."))
+    bool bCompactPCMStorage = false;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Drop silence at the start and end of a song while decoding. It is never stored, played or analyzed, and song time starts at the first sound."))
+    bool bTrimSilence = true;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ClampMax="0", EditCondition="bTrimSilence", ToolTip="Samples at or below this level count as silence, in dBFS."))
+    float SilenceThresholdDb = -70.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ToolTip="Endless mix: only keep a window of the song in memory. Audio is decoded at most StreamLeadSec ahead of playback and released again once playback and analysis are StreamKeepBehindSec past it, so memory stays flat however long the mix runs. Always starts progressively and skips the PCM cache."))
+    bool bEndlessMix = false;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ClampMin="5", ToolTip="How far the decoder may run ahead of playback in seconds in an endless mix. A playlist fetches its next song once less than this is left to play. Never less than the note travel time."))
+    float StreamLeadSec = 30.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Decode", meta=(ClampMin="0", EditCondition="bEndlessMix", ToolTip="Seconds of audio kept behind the slower of playback and analysis before they are released."))
+    float StreamKeepBehindSec = 5.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Playback", meta=(ClampMin="10", ClampMax="1000", ToolTip="How much converted audio the procedural wave is allowed to hold ahead of the mixer, in ms. Everything else stays in the decoded track until the wave asks for it."))
+    float StreamAheadMs = 100.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Playback", meta=(ToolTip="Add TPDF dither when WAV sources are converted to the 16-bit playback stream. MP3s are decoded to 16 bit and never need it."))
+    bool bDitherPlayback = false;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Practice", meta=(ClampMin="0.5", ClampMax="1.0", ToolTip="Plays songs slower without changing their pitch. Notes, scoring and the song clock follow the stretched audio, calibration zones always run at full speed."))
+    float PracticeSpeed = 1.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Practice", meta=(ClampMin="0", ToolTip="Start songs this many seconds in. The load decodes at least up to there before the song starts, notes before it are never shown."))
+    float StartAtSec = 0.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Practice", meta=(ClampMin="1", ClampMax="60", ToolTip="Seconds of song between two analysis checkpoints. A seek restores the one before its target and only analyzes the rest, so it never analyzes more than this on the calling thread."))
+    float AnalysisCheckpointSec = 5.0f;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Playlist", meta=(ToolTip="Let the player pick several songs and play them back to back in one session. Each next song is decoded and analyzed in the background while the one before it plays."))
+    bool bPlaylist = false;
+
+    UPROPERTY(EditAnywhere, Category="Rhythm|Playlist", meta=(ClampMin="10", EditCondition="bPlaylist", ToolTip="Longest playlist session in minutes. Songs that would run past it are left out."))
+    float PlaylistMaxMinutes = 240.0f;
+
+    //The grow limit of a playlist's streams is sized for this rate, faster songs just reach PlaylistMaxMinutes sooner
+    static constexpr int32 PlaylistMaxSampleRate = 96000;
+
+    float GetSilenceThreshold() const { return FMath::Pow(10.0f, SilenceThresholdDb / 20.0f); }
+
+    EPCMStorage GetPCMStorage() const { return bCompactPCMStorage ? EPCMStorage::Int16 : EPCMStorage::Float32; }
+
+    TSharedPtr<FAudioScratchPool, ESPMode::ThreadSafe> ScratchPool;
+
+    //The decoders write two streams in the same pass: FullPCM is the mono analysis stream, PlaybackPCM the interleaved int16 stream the
+    //player hears, with the source's channels folded down to at most stereo. Both are sized before decoding starts and only the first
+    //DecodedFrames frames are valid. Everything that runs while a load may still be decoding (pre-roll, analysis worker, playback feed)
+    //reads up to that watermark and never Num()
+    FPCMTrack FullPCM;
+    FPCMTrack PlaybackPCM;
+    int32 PlaybackChannels = 1;
+    AudioKernels::FTPDFDither PlaybackDither;
+    FLoudnessMeter Loudness;
+    FLoudnessStats LoudnessStats;
+
+    //Silence trimming. The trims are in source frames, DecodeWritten is the serial decoders' write position and SoundEnd is one past the
+    //last sample above the threshold, which is as far as the watermark is allowed to go. Both count from AppendBase, the frame the song
+    //being decoded starts at in the streams
+    int64 AppendBase         = 0;
+    int64 LeadingTrimFrames  = 0;
+    int64 TrailingTrimFrames = 0;
+    int64 DecodeWritten      = 0;
+    int64 SoundEnd           = 0;
+    std::atomic<int64> DecodedFrames { 0 };
+    FThreadSafeBool bDecodeComplete = false;
+
+    //Endless mix window. The decoder waits in WaitForStreamWindow while it is too far ahead of the feed. The game thread works out what
+    //both the feed and the analysis worker (AnalyzedFrames) have left behind and requests it, the decoder releases it between two blocks
+    std::atomic<int64> AnalyzedFrames { 0 };
+    std::atomic<int64> RequestedReleaseFrame { 0 };
+
+    //How far ahead of playback the decoder may run, which is also how early the next playlist song is fetched
+    int64 GetDecodeLeadFrames() const;
+    bool WaitForStreamWindow(int64 End);
+    void TickStreamWindow();
+    void ReleaseStreamWindow();
+
+    //Playlist. The songs after the first are decoded onto the end of the same two streams, so the feed, the clock, the analysis and the
+    //note queue carry on across the boundary as if it was one long song. PlaylistTask fetches one song at a time on a background priority
+    //task once less than the decode lead is left to play, and publishes it in one go, together with the onset gain the analysis switches to when it reaches NextTrackStartFrame
+    TArray<FString> PlaylistQueue;
+    UE::Tasks::TTask<bool> PlaylistTask;
+    bool  bAppendingTrack   = false;
+    FThreadSafeBool bMoreTracksComing = false;
+    std::atomic<int64> NextTrackStartFrame { -1 };
+    std::atomic<float> NextTrackEnergyScale { 1.0f };
+
+    void TickPlaylist();
+    bool AppendPlaylistTrack(const FString& FilePath);
+
+    //Playback is pulled by the procedural wave's underflow callback on the audio render thread. QueuedFrames is how far into PlaybackPCM it has
+    //been fed, StreamLock keeps StopAndReset from emptying the track under a callback that is converting a block
+    std::atomic<int64> QueuedFrames { 0 };
+
+    //Practice mode. With the stretch on, the wave is fed Stretch's output and WaveFrames counts that instead of the source frames. Note
+    //times are put on the stretched timeline by TimeScale (1 / speed), so the clock, the offsets and the scoring windows stay in real seconds
+    FTimeStretch Stretch;
+    TScopedScratch<int16> StretchScratch;
+    int64  WaveFrames = 0;
+    double TimeScale  = 1.0;
+    double GetPlayedDuration() const { return SongDuration * TimeScale; }
+    FCriticalSection StreamLock;
+    bool   bStreaming   = false;
+    int32  StreamAheadFrames = 0;
+    TScopedScratch<int16> StreamScratch;
     int32  SampleRate   = 0;
     double SongDuration = 0.0;
     double SongStartTime= 0.0;
     bool   bSongStarted = false;
 
+    //Song time follows what the render thread has consumed. The clock counts from the song start or the last seek, SongClockBase is the
+    //played time it started at and SongStartTime the wall-clock time it did, which is only used as the fallback for an audio device that never pulls
+    FAudioClock SongClock;
+    double SongClockBase = 0.0;
+    double GetSongTime() const;
+
     UPROPERTY()
     USoundWaveProcedural* ProcWave = nullptr;
 
     UPROPERTY()
     UAudioComponent* AudioComp = nullptr;
 
+    //Keysounds never spawn anything while a song runs, they are handed to one of these voices and started by the audio renderer at the
+    //start of the next buffer it mixes, so their latency is the mixer's buffer rather than the game frame. The Quartz clock is only the
+    //vehicle for that: it is not locked to the song's tempo or beat grid (the zone has no tempo estimate), and keysounds are never
+    //quantized to beats, they react to presses
+    UPROPERTY()
+    TArray<UAudioComponent*> KeysoundPool;
+
+    UPROPERTY()
+    UQuartzClockHandle* KeysoundClock = nullptr;
+
+    int32 NextKeysoundVoice = 0;
+
+    void CreateKeysoundPool();
+    void StartKeysoundClock();
+    void StopKeysoundClock();
+    void PlayKeysound(USoundBase* Sound);
+
     TQueue<FPrompt> PromptBuffer; 
     TArray<FActiveNote> ActiveNotes;
 
     FThreadSafeBool bAnalyzing    = false;
     FThreadSafeBool bSongFinished = false;
 
-    int32  SamplesPerHop         = 2048;
+    //The cursor counts source samples, the hop is counted at the analysis rate. Decimated samples wait in AnalysisFifo until a full hop is there
+    int32  SamplesPerHop         = 512;
+    double EffectiveAnalysisRate = 0.0;
     double HopDuration           = 0.0;
-    int32  AnalysisCursorSamples = 0;
+    int64  AnalysisCursorSamples = 0;
+    int64  AnalysisHopIndex      = 0;
+    TArray<float> AnalysisFifo;
+
+    //Everything the detector carries from one hop to the next. One is taken every AnalysisCheckpointSec before the hop that starts there,
+    //so restoring it and analyzing on from its cursor gives exactly the prompts the first pass gave. Only the analysis worker (or the
+    //pre-roll before it) writes them, SeekToTime reads them after the worker has stopped
+    struct FAnalysisCheckpoint
+    {
+        int64 CursorSamples = 0;
+        int64 HopIndex      = 0;
+        FBiquad KickBP, SnareBP;
+        FDecimator Decimator;
+        TArray<float> Fifo;
+        float  PrevKickEnergy  = 0.0f;
+        float  PrevSnareEnergy = 0.0f;
+        double LastKickTime    = -1000.0;
+        double LastSnareTime   = -1000.0;
+        float  OnsetEnergyScale = 1.0f;
+    };
+    TArray<FAnalysisCheckpoint> Checkpoints;
+    int64 NextCheckpointSamples = 0;
+
+    //Onset gains of the playlist songs by their start frame, kept so that analysis that is sent back before a boundary switches again.
+    //NextTrackGain is the first one the cursor has not reached
+    TArray<TPair<int64, float>> TrackGains;
+    int32 NextTrackGain = 0;
+
+    void AnalyzeHop(float* Scratch, int32 NumSamples);
+    void SaveCheckpoint();
+    void RestoreCheckpoint(const FAnalysisCheckpoint& Checkpoint);
+    bool RestartAnalysisWithGain(float EnergyScale);
+    void RenormalizeOnsets();
 
     float  PrevEnergy        = 0.0f;
     double MinOnsetSpacing   = 0.18;
     double LastOnsetTime     = -1000.0;
     float  FluxThreshold     = 0.03f;
 
+    //Load state. LoadGeneration and bLoading are only touched on the game thread, the worker publishes progress and watches bCancelLoad
+    bool   bLoading = false;
+    uint32 LoadGeneration = 0;
+    uint32 WorkerLoadGeneration = 0;
+    FString WorkerFilePath;
+    bool   bStartDispatched = false;
+    bool   bProgressiveLoad = false;
+    FThreadSafeBool bCancelLoad = false;
+    std::atomic<float> LoadProgress { 0.0f };
+    std::atomic<uint64> DownmixCycles { 0 };
+    bool   bDecodedParallel = false;   //Whether the last DecodeMp3 went through the sharded path, for the decode benchmark
+    float  LastBroadcastProgress = -1.0f;
+
     void AskForFile();
     void LoadAndDecodeAudio(const FString& FilePath);
-    bool DecodeWav(const FString& FilePath);
-    bool DecodeMp3(const FString& FilePath);
+    bool DecodeAndPreRoll(const FString& FilePath);
+    void FinishLoad(const FString& FilePath, uint32 Generation, bool bOk);
+    void OnDecodeComplete(uint32 Generation, int64 TotalFrames);
+    void DispatchSongStart(bool bOk);
+    void DispatchDecodeComplete(int64 TotalFrames);
+    void PublishDecoded(int64 NumDecoded, int64 ExpectedFrames);
+    void CancelLoad();
+    bool BeginDecode(int64 TotalFrames, int32 InSampleRate, int32 InPlaybackChannels);
+    template <typename SampleType>
+    void AppendDecoded(const float* Mono, const SampleType* Playback, int32 Frames, int64 TotalFrames);
+    void WritePlayback(int64 Frame, const float* Src, int32 Frames);
+    void WritePlayback(int64 Frame, const int16* Src, int32 Frames);
+    void EndDecode();
+    bool DecodeWav(const FAudioIngest& Source);
+    bool DecodeMp3(const FAudioIngest& Source);
+    bool DecodeMp3Parallel(const FAudioIngest& Source, int32 Channels, int64 TotalFrames, int32 NumShards);
 
     void StartSong();
-    USoundWaveProcedural* CreateProceduralFromPCM(const TArray<float>& PCM, int32 InSampleRate);
+    USoundWaveProcedural* CreateProceduralFromPCM(int32 InSampleRate);
+    void OnStreamUnderflow(USoundWaveProcedural* SW, int32 SamplesRequired);
+    void StreamBlock(USoundWaveProcedural* SW, int32 FramesRequired);
+    void StreamStretched(USoundWaveProcedural* SW, int32 Count, int64 Cursor, int64 Available);
 
     void PreRollAnalysis();
     void StartContinuousAnalysis();
     void AnalysisWorker();
     void ProcessFrameForOnsets(const float* Frame, int32 NumSamples, double FrameStartTime);
+    void FeedAnalysis(const float* Samples, int32 NumSamples);
+    int32 GetSourceSamplesPerHop() const { return FMath::CeilToInt(SamplesPerHop * AnalysisDecimator.Ratio); }
 
     void DrainAndSpawn(double Now);
     void UpdateActiveNotes(double Now);
 
     void StartZoneSession();
+
+    //Calibration. The tap times are raw song clock readings, the beats are where the clicks and the silent notes land
+    bool bCalibrating = false;
+    TArray<double> CalibrationAudioBeats;
+    TArray<double> CalibrationVisualBeats;
+    TArray<double> CalibrationTaps;
+
+    void StartCalibration();
+    void FinishCalibration();
+    void LoadSavedSync();
     void StopAndReset();
 
     UFUNCTION()
@@ -203,7 +586,6 @@ private:
     void OnTriggerEnd(UPrimitiveComponent* OverlappedComp, AActor* Other, UPrimitiveComponent* OtherComp, int32 BodyIndex);
 
     FTimerHandle FileAskDelayHandle;
-    FTimerHandle SongEndHandle;
 
     TArray<FHitWindow> Upcoming;
 
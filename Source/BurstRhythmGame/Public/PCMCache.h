@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "LoudnessMeter.h"
+#include "PCMTrack.h"
+
+//What a cache entry remembers about the decode besides the samples themselves
+struct FPCMCacheMeta
+{
+    int32 SampleRate = 0;
+    FLoudnessStats Loudness;
+    int64 LeadingTrimFrames = 0;
+    int32 PlaybackChannels = 0;
+};
+
+//Decode settings that change the samples of an entry. They are folded into the entry key next to the source hash
+struct FPCMCacheSettings
+{
+    bool  bTrimSilence = false;
+    float SilenceThresholdDb = 0.0f;
+    bool  bDitherPlayback = false;
+};
+
+//On-disk cache of decoded songs under Saved/PCMCache, the mono analysis stream and the interleaved int16 playback stream. Entries are named after
+//a key made from a hash of the source file's bytes and the decode settings, so a renamed or copied file still hits while an edited file or a
+//changed trim or dither setting misses. Each entry is a small header followed by the raw analysis samples in the storage format
+//of the track that wrote it and then the playback samples, laid out so a hit can play straight from the mapping.
+//All functions are safe to call from the load worker, concurrent writers of the same entry are resolved by writing to a temp file and renaming it.
+//The ones that walk a whole song take the load's cancel flag and check it between blocks of a few MB, so cancelling a load never waits on them
+class BURSTRHYTHMGAME_API FPCMCache
+{
+public:
+    static FString GetCacheDir();
+
+    //Hashes the full contents of the source file, as handed over by the ingest stage that already has it mapped or in memory.
+    //Stops early once bCancel is set, the hash is meaningless then and the caller has to check the flag
+    static uint64 HashSource(const uint8* Data, int64 NumBytes, const FThreadSafeBool& bCancel);
+
+    //The entry key for a source hash decoded with Settings. The silence threshold only counts while trimming is on
+    static uint64 MakeKey(uint64 SourceHash, const FPCMCacheSettings& Settings);
+
+    //Maps a cached entry and points OutTrack and OutPlayback straight at it, read-only, and touches it so the LRU eviction keeps it around.
+    //Tracks with a grow limit and analysis samples written in the other storage format are copied (and converted) into chunks instead.
+    //Returns false on a miss, a stale/corrupt entry or when a copy is cancelled half way
+    static bool Load(uint64 Key, EPCMStorage Storage, FPCMTrack& OutTrack, FPCMTrack& OutPlayback, FPCMCacheMeta& OutMeta, const FThreadSafeBool& bCancel);
+
+    //Writes an entry and then evicts the least recently used entries until the cache fits into MaxBytes. Playback has to be an int16 track
+    //with Meta.PlaybackChannels samples for every sample of Track. A cancelled store deletes its temp file and leaves the cache as it was
+    static bool Store(uint64 Key, const FPCMTrack& Track, const FPCMTrack& Playback, const FPCMCacheMeta& Meta, int64 MaxBytes, const FThreadSafeBool& bCancel);
+
+private:
+    static FString GetEntryPath(uint64 Key);
+    static void EvictToFit(int64 MaxBytes, const FString& KeepPath);
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+class FAudioScratchPool;
+namespace AudioKernels { struct FTPDFDither; }
+
+//How a decoded track is kept in memory. Int16 halves the resident size and is lossless for MP3 sources, which only have 16 bits to begin with
+enum class EPCMStorage : uint8
+{
+    Float32,
+    Int16,
+};
+
+//Whatever keeps the memory behind a mapped track valid (see FPCMTrack::MapReadOnly), released with the last track that uses it
+class FPCMTrackMapping
+{
+public:
+    virtual ~FPCMTrackMapping() = default;
+};
+
+//PCM for one song in either storage format, either the mono analysis stream or the interleaved playback stream (the track only counts
+//samples, the caller keeps track of channels). Samples are written as float or int16 and can be read back as either, the conversion
+//only ever happens on the block that is asked for. The track is sized once with Allocate and never reallocates after that, so disjoint
+//ranges can be written and read from different threads as long as the caller tracks which part is valid. A track with a grow limit
+//can also be extended at the end while it is being read, see SetGrowLimit, and have the chunks behind its readers released, see
+//ReleaseBefore. Together they let a track slide over a song that is never resident as a whole.
+//
+//Only one thread may change the size (Allocate, Extend, Truncate, ReleaseBefore, Empty), and all of them have to come from that thread.
+//An endless mix has its game thread request releases, the load worker that extends the track carries them out. The table of chunk slots
+//itself is only resized by Allocate and Empty, which need the track to be idle; Extend and ReleaseBefore only fill or empty slots and then
+//publish the new end or start with a release store, so a reader that loads Num() or GetFirstResident() sees every chunk inside that range.
+//
+//The samples live in fixed-size chunks addressed by 64-bit positions, so a multi-hour mix is a few hundred small allocations instead of one
+//huge contiguous one. Block sizes (Count) stay 32-bit, only positions and lengths of the whole track are 64-bit. A read that fits inside one
+//chunk is handed back in place, one that straddles a chunk boundary is gathered into the caller's scratch buffer.
+//
+//With a scratch pool set, chunks are borrowed from it and handed back whenever the track shrinks, is emptied or destroyed.
+//
+//A track can also be pointed at samples that are already in memory, a mapped cache entry, instead of owning chunks. Such a track is
+//read-only until the next Allocate or Empty, reads still go chunk by chunk and hand back pointers straight into the mapping.
+//
+//Int16 tolerance: samples are scaled by 32768, rounded and clamped, so the error per sample is at most half an LSB (1.53e-5). For material
+//above -40 dBFS that keeps the kick/snare band energies within ~1e-3 relative of the float path, so onset decisions only differ when a flux
+//value lands within that distance of its threshold
+class BURSTRHYTHMGAME_API FPCMTrack
+{
+public:
+    FPCMTrack() = default;
+    FPCMTrack(const FPCMTrack&) = delete;
+    FPCMTrack& operator=(const FPCMTrack&) = delete;
+    ~FPCMTrack();
+
+    //2^20 samples per chunk, 4 MB of float or 2 MB of int16 (about 24 s at 44.1 kHz)
+    static constexpr int32 ChunkShift   = 20;
+    static constexpr int64 ChunkSamples = 1ll << ChunkShift;
+
+    void SetPool(const TSharedPtr<FAudioScratchPool, ESPMode::ThreadSafe>& InPool) { Pool = InPool; }
+
+    //Lets the track grow with Extend up to MaxSamples. It applies from the next Allocate on, which then creates the chunk slots for the
+    //whole limit and gives every chunk its full size, so growing never moves anything a reader may be holding. 0 turns it off
+    void SetGrowLimit(int64 MaxSamples) { GrowLimit = FMath::Max<int64>(MaxSamples, 0); }
+    int64 GetGrowLimit() const { return GrowLimit; }
+    bool CanGrowTo(int64 NewNum) const { return NewNum <= Num() || (GrowLimit > 0 && NewNum <= GrowLimit && GetNumChunksFor(NewNum) <= Chunks.Num()); }
+
+    void Allocate(EPCMStorage InStorage, int64 NumSamples);
+
+    //Points the track at InNumSamples contiguous samples of InStorage at Data instead of copying them. InMapping is held until the track
+    //is allocated again, emptied or destroyed. Writing, extending or handing out writable chunks of a mapped track is an error
+    void MapReadOnly(EPCMStorage InStorage, const uint8* Data, int64 InNumSamples, const TSharedPtr<FPCMTrackMapping, ESPMode::ThreadSafe>& InMapping);
+    bool IsMapped() const { return MappedData != nullptr; }
+    void Extend(int64 NewNum);
+    void Truncate(int64 NewNum);
+    void Empty();
+
+    //Hands back every chunk that lies completely before Position. Positions stay where they are, reading or writing below
+    //GetFirstResident afterwards is an error
+    void ReleaseBefore(int64 Position);
+    int64 GetFirstResident() const { return FirstResident.load(std::memory_order_acquire); }
+
+    int64 Num() const { return NumSamples.load(std::memory_order_acquire); }
+    EPCMStorage GetStorage() const { return Storage; }
+    int32 GetBytesPerSample() const { return Storage == EPCMStorage::Int16 ? sizeof(int16) : sizeof(float); }
+    SIZE_T GetAllocatedSize() const;
+
+    //Stores Count samples at Offset, converting them if the track has the other storage format. Float to int16 is dithered if Dither is set
+    void Write(int64 Offset, const float* Src, int32 Count, AudioKernels::FTPDFDither* Dither = nullptr);
+    void Write(int64 Offset, const int16* Src, int32 Count);
+
+    //Float tracks hand back a pointer straight into the storage, int16 tracks and reads across a chunk boundary go through Scratch (Count floats)
+    const float* ReadFloat(int64 Offset, int32 Count, float* Scratch) const;
+
+    //The same the other way around, int16 tracks are returned in place and float tracks are converted into Scratch, dithered if Dither is set
+    const int16* ReadInt16(int64 Offset, int32 Count, int16* Scratch, AudioKernels::FTPDFDither* Dither = nullptr) const;
+
+    //The chunks in their storage format, for code that moves the track around as a whole (the disk cache). Chunk i starts at sample i * ChunkSamples
+    int32 GetNumChunks() const { return GetNumChunksFor(Num()); }
+    int32 GetChunkNum(int32 ChunkIndex) const { return (int32)FMath::Min<int64>(ChunkSamples, Num() - (int64)ChunkIndex * ChunkSamples); }
+    uint8* GetChunkData(int32 ChunkIndex) { check(!MappedData); return Chunks[ChunkIndex].GetData(); }
+    const uint8* GetChunkData(int32 ChunkIndex) const { return MappedData ? MappedData + ((int64)ChunkIndex << ChunkShift) * GetBytesPerSample() : Chunks[ChunkIndex].GetData(); }
+
+private:
+    template <typename SampleType>
+    SampleType* SamplePtr(int64 Position) { return reinterpret_cast<SampleType*>(Chunks[(int32)(Position >> ChunkShift)].GetData()) + (Position & (ChunkSamples - 1)); }
+    template <typename SampleType>
+    const SampleType* SamplePtr(int64 Position) const
+    {
+        if (MappedData)
+            return reinterpret_cast<const SampleType*>(MappedData) + Position;
+        return reinterpret_cast<const SampleType*>(Chunks[(int32)(Position >> ChunkShift)].GetData()) + (Position & (ChunkSamples - 1));
+    }
+
+    void ReleaseChunks(int32 FirstChunk, int32 EndChunk);
+    TArray<uint8> AcquireChunk(int32 ChunkBytes) const;
+
+    static int32 GetNumChunksFor(int64 Num) { return (int32)((Num + ChunkSamples - 1) >> ChunkShift); }
+
+    //How many samples from Position on sit in the same chunk
+    static int32 ContiguousFrom(int64 Position) { return (int32)(ChunkSamples - (Position & (ChunkSamples - 1))); }
+
+    EPCMStorage Storage = EPCMStorage::Float32;
+    std::atomic<int64> NumSamples { 0 };
+    int64 GrowLimit = 0;
+    std::atomic<int64> FirstResident { 0 };
+    //One slot per chunk up to the grow limit, slots outside [FirstResident, NumSamples) hold no memory
+    TArray<TArray<uint8>> Chunks;
+    TSharedPtr<FAudioScratchPool, ESPMode::ThreadSafe> Pool;
+    //Set instead of Chunks while the track is mapped
+    const uint8* MappedData = nullptr;
+    TSharedPtr<FPCMTrackMapping, ESPMode::ThreadSafe> Mapping;
+};
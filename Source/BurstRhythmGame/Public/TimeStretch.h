@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+//WSOLA time-stretch for the practice mode, plays interleaved int16 audio slower without changing its pitch. The output is built from
+//Hann-windowed segments of the input that overlap by half a segment. Every segment is taken from around where the input should be at
+//this speed, shifted by up to SearchMs to the spot whose start looks most like the audio that would have followed the previous segment,
+//so the overlaps add up in phase. The search runs on a mono mix of the input through AudioKernels::DotProduct.
+//
+//Streaming and allocation-free after Init, so it can run in the audio render thread's callback: the caller pushes the input that
+//GetInputNeeded asks for and pulls output in whatever block size it likes. Output frame n plays input frame n * Speed, give or take the
+//search range. Once the input has ended, Finish lets the output run on to the frame that plays its last frame
+class BURSTRHYTHMGAME_API FTimeStretch
+{
+public:
+    static constexpr float SegmentMs = 40.0f;
+    static constexpr float SearchMs  = 8.0f;
+
+    //A speed of 1 or no channels leaves the stage off
+    void Init(int32 SampleRate, int32 InChannels, float InSpeed);
+
+    //Drops everything buffered, the next input pushed is the start of a new stream
+    void Reset();
+
+    bool IsActive() const { return Channels > 0 && Speed != 1.0f; }
+    float GetSpeed() const { return Speed; }
+
+    //Input frames the next hop is still missing, and the most that can ever be missing at once
+    int32 GetInputNeeded() const;
+    int32 GetMaxInputNeeded() const { return InputCapacity; }
+
+    void Push(const int16* Samples, int32 NumFrames);
+
+    //No more input is coming. The hops still owed run on silence past the end, so the last segment is windowed out rather than left in
+    //Overlap, and Pull stops at input length / Speed frames. Reset starts a new stream
+    void Finish();
+    bool IsFinished() const { return bFinished; }
+
+    //Writes up to MaxFrames interleaved frames and runs hops for as long as the pushed input lasts. Returns the frames written
+    int32 Pull(int16* Out, int32 MaxFrames);
+
+private:
+    int64 GetRequiredEnd() const;
+    void PushSilence(int32 NumFrames);
+    void RunHop();
+
+    int32  Channels      = 0;
+    float  Speed         = 1.0f;
+    int32  HopOut        = 0;
+    int32  SegmentFrames = 0;
+    int32  SearchFrames  = 0;
+    double HopIn         = 0.0;
+
+    //Input holds interleaved frames from InputBase on and InputMono the same frames mixed down for the search
+    TArray<float> Input;
+    TArray<float> InputMono;
+    int32 InputCapacity = 0;
+    int32 InputFrames   = 0;
+    int64 InputBase     = 0;
+
+    //Where the next segment should come from at this speed, and where the last one actually came from
+    double IdealPos = 0.0;
+    int64  PrevPos  = -1;
+
+    //Window is interleaved like the input. Overlap is the windowed second half of the last segment, Output the finished hop
+    TArray<float> Window;
+    TArray<float> Overlap;
+    TArray<float> Output;
+    int32 OutputRead = 0;
+
+    //Frames pulled since Reset, and after Finish the number the whole stream comes to
+    int64 OutputFrames      = 0;
+    int64 FinalOutputFrames = 0;
+    bool  bFinished         = false;
+};